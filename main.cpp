@@ -6,6 +6,10 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 #include "ultis/shaderReader.h"
+#include "ultis/uniformBuffer.h"
+#include "ultis/frameUniforms.h"
+#include "ultis/renderGraph.h"
+#include "ultis/renderQueue.h"
 #include "ultis/camera.h"
 #include "ultis/model.h"
 #include "terrain/terrain.h"
@@ -13,6 +17,9 @@
 #include "object/water.h"
 #include "object/light.h"
 #include "object/spotLight.hpp"
+#include "object/lightClusters.h"
+#include "object/placement.h"
+#include "object/shadowCascades.h"
 #include "object/sphere.hpp"
 #include "terrain/lodterrain.h"
 #include <glm/glm.hpp>
@@ -26,9 +33,11 @@
 //global values
 static const int SCR_WIDTH = 1280;
 static const int SCR_HEIGHT = 720;
-const unsigned int SHADOW_WIDTH  = 720;
-const unsigned int SHADOW_HEIGHT = 720;
+const int SHADOW_CASCADE_SIZE = 1024;   // per cascade
+const float SHADOW_DISTANCE = 1000.0f;  // cascades end here (or at fogEnd)
 float WATER_HEIGHT = -110.5f;
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR  = 10000.0f;
 float fogStart = 350.f;
 float fogEnd = 1250.f;
 float terrainScale = 64.0f;
@@ -46,16 +55,6 @@ static const int NUM_TREES = 25;
 static const int NUM_LAMPS = 5;
 
 
-
-std::vector<glm::vec2> lampPositions;
-std::vector<glm::vec2> treePositions;
-std::vector<SpotLight> lampLights;
-std::vector<glm::vec3> bulbWorldPositions;
-
-
-// Framebuffer và texture để lưu depth từ ánh sáng
-GLuint depthMapFBO = 0;
-GLuint depthMap    = 0;
 glm::vec3 fogColor = glm::vec3(0.7f, 0.8f, 1.0f);
 // setup light
 glm::vec3 lightPos = glm::vec3(0.0f, 150.0f, 0.0f);
@@ -118,15 +117,46 @@ int main()
     Shader litShader("shaders/lit.vs", "shaders/lit.fs");
     Shader waterShader("shaders/water.vs", "shaders/water.fs");
     Shader depthShader("shaders/shadow_depth.vs", "shaders/shadow_depth.fs");
+    Shader terrainDepthShader("shaders/terrain_depth.vs", "shaders/shadow_depth.fs");
     Shader sphereShader("shaders/lightSphere.vs", "shaders/lightSphere.fs");
     Shader treeShader = litShader;
     Shader lampShader = litShader;
 
+    // camera / sun / fog / water tint shared by terrain, lit and water
+    UniformBuffer<CameraBlock> cameraUniforms(kCameraBlockBinding);
+    UniformBuffer<FrameBlock>  frameUniforms(kFrameBlockBinding);
+    bindFrameBlocks(terrainShader);
+    bindFrameBlocks(litShader);     // also treeShader / lampShader: same program
+    // lamp spotlights, binned into view-space clusters every frame; the
+    // mirrored reflection camera gets its own
+    LightClusters lightClusters(CAMERA_NEAR, CAMERA_FAR);
+    LightClusters reflectionClusters(CAMERA_NEAR, CAMERA_FAR);
+    auto setCamera = [&](const glm::mat4& view, const glm::mat4& proj, const glm::vec3& pos) {
+        cameraUniforms.update(CameraBlock{view, proj, pos, 0.0f, lightClusters.depthParams(), {0.0f, 0.0f}});
+    };
+
+    // uniforms that never change, set once
+    terrainShader.use();
+    terrainShader.setInt("albedoMap",   0);
+    terrainShader.setInt("normalMap",   1);
+    terrainShader.setMat4("model",      glm::mat4(1.0f));
+    terrainShader.setFloat("worldScale", worldSize);
+    LightClusters::setSamplers(terrainShader);
+    ShadowCascades::setSamplers(terrainShader);
+    terrainDepthShader.use();
+    terrainDepthShader.setMat4("model", glm::mat4(1.0f));
+    litShader.use();
+    LightClusters::setSamplers(litShader);
+    ShadowCascades::setSamplers(litShader);
+
     LightSphere lightViz(16, 16, lightColor);
     Sphere lightSphere;
     lightSphere.build(32, 16); 
 
+    // textures and models decode on workers and reach GL in assets.upload()
+    AssetLoader assets;
     LodTerrain lodTerrain(
+        assets,
         /*tileSize=*/128,
         /*lodLevels=*/4,
         /*scale=*/worldSize,
@@ -135,122 +165,103 @@ int main()
         "assets/texture/ground/textures/aerial_rocks_04_diff_1k.jpg",
         "assets/texture/ground/textures/aerial_rocks_04_nor_gl_1k.jpg");
 
-    Skybox skybox({"assets/skybox/right.jpg", "assets/skybox/left.jpg",
+    Skybox skybox(assets,
+                  {"assets/skybox/right.jpg", "assets/skybox/left.jpg",
                    "assets/skybox/top.jpg", "assets/skybox/bottom.jpg",
                    "assets/skybox/front.jpg", "assets/skybox/back.jpg"});
     Water water(
+        assets,
         "assets/texture/waterDudv.png",
         "assets/texture/waterNormal.png",
         SCR_WIDTH * 1.5, SCR_HEIGHT * 1.5,
         WATER_HEIGHT,
         worldSize);
-    Model tree("assets/model/lowpolytree/Tree3_1.obj");
-    Model lamp("assets/model/lamp/LAMP_OBJ.obj");
+    Model tree(assets, "assets/model/lowpolytree/Tree3_1.obj");
+    Model lamp(assets, "assets/model/lamp/LAMP_OBJ.obj");
+    // everything above was requested at once; wait for the last upload
+    assets.finish();
     
     
     
-    float treeBaseOffset = 0.0f;
-    {
-        bool firstVertex = true;
-        for (const auto& mesh : tree.meshes) {
-            for (const auto& v : mesh.vertices) {
-                float vy = v.Position.y;
-                if (firstVertex) {
-                    treeBaseOffset = vy;
-                    firstVertex = false;
-                } else {
-                    treeBaseOffset = std::min(treeBaseOffset, vy);
+    std::cout << "treeBaseOffset = " << tree.bounds.min.y << std::endl;
+    std::cout << "lampTopOffset = " << lamp.bounds.max.y << std::endl;
+    // transforms, bulbs and spotlights of everything placed, rebuilt only when
+    // the placement or the terrain under it changes
+    StaticPlacement placement(tree.bounds, lamp.bounds, lightSphere.bounds);
+    // what each pass draws of it, culled against that pass's frustum
+    struct PassInstances { VisibleInstances trees, lamps, bulbs; };
+    PassInstances shadowVisible[kShadowCascades], reflectionVisible, mainVisible;
+    // trees and lamps stand on the terrain, which is built in the background:
+    // placed from the render loop once the centre tile's heights exist
+    bool objectsPlaced = false;
+    auto placeObjects = [&]() {
+        std::vector<glm::vec2> treePositions, lampPositions;
+        {
+            std::mt19937 gen((unsigned int)glfwGetTime());
+            std::uniform_real_distribution<float> distXZ(-worldSize * 0.5f, worldSize * 0.5f);
+
+            // rejection sampling in batches: one terrain query per batch
+            std::vector<glm::vec2> candidates(64);
+            std::vector<float> heights(candidates.size());
+            while ((int)treePositions.size() < NUM_TREES) {
+                for (auto& c : candidates) c = glm::vec2(distXZ(gen), distXZ(gen));
+                lodTerrain.getHeightsAt(candidates.data(), candidates.size(), heights.data());
+                for (std::size_t i = 0; i < candidates.size() && (int)treePositions.size() < NUM_TREES; ++i) {
+                    if (heights[i] > WATER_HEIGHT) {
+                        treePositions.push_back(candidates[i]);
+                    }
                 }
             }
-        } 
-        std::cout << "treeBaseOffset = " << treeBaseOffset << std::endl;
-    }
-    //just calculate max distance from surface to highest point of lamp object (from spotligh placing)
-    {
-        float lampTopOffset = -std::numeric_limits<float>::infinity();
-        for (const auto& mesh : lamp.meshes) {
-            for (const auto& v : mesh.vertices) {
-                lampTopOffset = std::max(lampTopOffset, v.Position.y);
-            }
         }
-        std::cout << "lampTopOffset = " << lampTopOffset << std::endl;
-    }
-    {
-        std::mt19937 gen((unsigned int)glfwGetTime());
-        std::uniform_real_distribution<float> distXZ(-worldSize * 0.5f, worldSize * 0.5f);
-
-        treePositions.clear();
-        while ((int)treePositions.size() < NUM_TREES) {
-            float rx = distXZ(gen);
-            float rz = distXZ(gen);
-            float ry = lodTerrain.getHeightAt(rx, rz);
-            if (ry > WATER_HEIGHT) {
-                treePositions.emplace_back(rx, rz);
-            }
-        }
-    }
 
-    {
-        std::mt19937 gen((unsigned int)glfwGetTime() + 121);   
-        std::uniform_real_distribution<float> distXZ(-worldSize / 2.3, worldSize / 2.3);
-
-        lampPositions.clear();
-        while ((int)lampPositions.size() < NUM_LAMPS) {
-            float rx = distXZ(gen);
-            float rz = distXZ(gen);
-            float ry = lodTerrain.getHeightAt(rx, rz);
-            if (ry > WATER_HEIGHT) {
-                lampPositions.emplace_back(rx, rz);
+        {
+            std::mt19937 gen((unsigned int)glfwGetTime() + 121);   
+            std::uniform_real_distribution<float> distXZ(-worldSize / 2.3, worldSize / 2.3);
+
+            std::vector<glm::vec2> candidates(64);
+            std::vector<float> heights(candidates.size());
+            while ((int)lampPositions.size() < NUM_LAMPS) {
+                for (auto& c : candidates) c = glm::vec2(distXZ(gen), distXZ(gen));
+                lodTerrain.getHeightsAt(candidates.data(), candidates.size(), heights.data());
+                for (std::size_t i = 0; i < candidates.size() && (int)lampPositions.size() < NUM_LAMPS; ++i) {
+                    if (heights[i] > WATER_HEIGHT) {
+                        lampPositions.push_back(candidates[i]);
+                    }
+                }
             }
         }
-    }
-
+        placement.place(std::move(treePositions), std::move(lampPositions));
+    };
 
 
-    //create depth map for shadow
-    {
-        glGenTextures(1, &depthMap);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 
-                    SHADOW_WIDTH, SHADOW_HEIGHT, 
-                    0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-        // Filter ± wrap
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-        // 2) Tạo framebuffer depthMapFBO và attach depthMap làm DEPTH_ATTACHMENT
-        glGenFramebuffers(1, &depthMapFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-        // Chỉ cần depth, không cần color
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            std::cerr << "ERROR::SHADOW_MAP:: Framebuffer not complete!" << std::endl;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    }
 
+    // sun shadows; the placement scales trees and lamps by 1.5
+    ShadowCascades shadows(SHADOW_CASCADE_SIZE,
+                           1.5f * std::max(tree.bounds.max.y - tree.bounds.min.y, lamp.bounds.max.y));
 
-    //calc heigh of 2 bulb (model)
-    float lampModelTopY = -FLT_MAX;
-    for (auto const& mesh : lamp.meshes) {
-        for (auto const& v : mesh.vertices) {
-            lampModelTopY = max(lampModelTopY, v.Position.y);
-        }
+    // offscreen targets the frame's passes draw into; the passes themselves
+    // are declared every frame in the render loop
+    RenderGraph graph(SCR_WIDTH, SCR_HEIGHT);
+    RenderGraph::Target shadowTargets[kShadowCascades], esmTargets[kShadowCascades];
+    for (int c = 0; c < kShadowCascades; ++c) {
+        shadowTargets[c] = graph.addTarget("shadowCascade", shadows.framebuffer(c),
+                                           shadows.resolution(), shadows.resolution(), GL_DEPTH_BUFFER_BIT);
+        // the resolve writes every texel, nothing to clear
+        esmTargets[c] = graph.addTarget("shadowEsm", shadows.esmFramebuffer(c),
+                                        shadows.esmResolution(), shadows.esmResolution(), 0);
     }
-    // pick a small horizontal offset to spread the two bulbs apart
-    float armOffsetX = 1.8f;
+    const RenderGraph::Target reflectionTarget = graph.addTarget(
+        "reflection", water.getReflectionFBO(), water.getTextureWidth(), water.getTextureHeight(),
+        GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    const RenderGraph::Target refractionTarget = graph.addTarget(
+        "refraction", water.getRefractionFBO(), water.getTextureWidth(), water.getTextureHeight(),
+        GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    graph.onCamera([&](const RenderGraph::Camera& c) { setCamera(c.view, c.projection, c.position); });
+    // mesh draws of a pass, sorted by program / textures / VAO before they're issued
+    RenderQueue drawQueue;
+    GLStateCache glState;
+
 
-    std::vector<glm::vec4> bulbLocals = {
-    // in LOCAL lamp‐space, use the real model top Y
-        glm::vec4(0.0f, lampModelTopY - 1.7f,  armOffsetX, 1.0f),  // left
-        glm::vec4(0.0f, lampModelTopY - 1.7f,  -armOffsetX, 1.0f),  // right
-    };
     // — Render loop —
     while (!glfwWindowShouldClose(window))
     {
@@ -260,42 +271,23 @@ int main()
         lastFrame = current;
         processInput(window);
 
+        // stream terrain tiles around the camera (bounded GL work per frame)
+        lodTerrain.update(camera.Position);
+        if (!objectsPlaced && lodTerrain.hasHeightsAt(0.0f, 0.0f)) {
+            placeObjects();
+            objectsPlaced = true;
+        }
+        // no-op unless the placement or the terrain under it changed. objects
+        // moved by terrain changes sit in regions the shadow layers already
+        // check; new positions can land under any layer
+        placement.update(lodTerrain);
+        if (placement.repositioned())
+            shadows.invalidate();
+
         dudvMove += deltaTime * 0.02f;
         dudvMove = fmod(dudvMove, .2f);
 
 
-        //spotlight 
-        bulbWorldPositions.clear();
-        lampLights.clear();
-
-        for (auto const & pos : lampPositions) {
-            float lx = pos.x, lz = pos.y;
-            float ly = lodTerrain.getHeightAt(lx, lz);
-
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(lx, ly, lz))
-                        * glm::scale(glm::mat4(1.0f), glm::vec3(1.5f));
-
-            
-
-            for (int i = 0; i < 2; ++i) {
-                glm::vec3 bulbWorld = glm::vec3(M * bulbLocals[i]);
-                bulbWorldPositions.push_back(bulbWorld);
-
-                glm::vec3 bulbDir = glm::normalize(glm::vec3(0, -1, (i==0?+1.f:-1.f)));
-
-                SpotLight light(glm::vec3(1,0.85f,0.6f), 45.5f, 60.5f);
-                light.Position    = bulbWorld;
-                light.Direction   = bulbDir;
-                light.CutOff      = glm::cos(glm::radians(45.0f));
-                light.OuterCutOff = glm::cos(glm::radians(60.5f));
-                light.Constant    = 1.0f;
-                light.Linear      = 0.02f;
-                light.Quadratic   = 0.005f;
-                lampLights.push_back(light);
-            }
-        }
-
-
 
         // ———————— Sun‐Cycle Update ————————
         const float DAY_LENGTH = dayNightCycleSeconds;
@@ -340,500 +332,173 @@ int main()
 
 
 
-        // 1) Tính ma trận chiếu ánh sáng (lightSpaceMatrix)
-        glm::mat4 lightSpaceMatrix;
-        if (lightPos.y > 0.0f) {
-            glm::vec3 terrainCenter = glm::vec3(0.0f);
-
-            // Hướng ánh sáng gốc
-            glm::vec3 dir = glm::normalize(lightPos - terrainCenter);
-            // Chỉ giữ thành phần y ≥ 0 để frustum không bị ngược
-            if (dir.y < 0.0f) dir.y = fabs(dir.y);
-            dir = glm::normalize(dir);
-
-            float dist = worldSize * 0.75f;
-            glm::vec3 lightEye  = terrainCenter + dir * dist;
-            glm::vec3 lightTarget = terrainCenter;
-            glm::vec3 up = glm::vec3(0,1,0);
-
-            glm::mat4 lightView = glm::lookAt(lightEye, lightTarget, up);
-            float near_plane = 1.0f, far_plane = 2000.0f;
-            float orthoSize = worldSize * 0.5f;
-            glm::mat4 lightProjection = glm::ortho(-orthoSize, orthoSize,
-                                                -orthoSize, orthoSize,
-                                                    near_plane, far_plane);
-            lightSpaceMatrix = lightProjection * lightView;
-        }
-
-
+        // towards the sun; the cascades aren't drawn at all while it's down
+        glm::vec3 sunDir = glm::normalize(lightPos);
 
         // common matrices
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 proj = glm::perspective(
             glm::radians(camera.Zoom),
             float(SCR_WIDTH) / SCR_HEIGHT,
-            0.1f, 10000.0f);
-        lightViz.Draw(proj, view, lightPos, sphereScale);
-
-
-        // --- DEPTH PASS: chỉ khi lightPos.y > 0 ---
-        
-        depthShader.use();
-        depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        //  Vẽ terrain vào shadow map
-        glm::mat4 modelTerrain = glm::mat4(1.0f);
-        depthShader.setMat4("model", modelTerrain);
-        lodTerrain.Draw(camera.Position);
-
-        //  Vẽ cây vào shadow map
-        for (auto& pos : treePositions) {
-            float wx = pos.x, wz = pos.y;
-            float wy = lodTerrain.getHeightAt(wx, wz);
-            glm::mat4 treeModel = glm::translate(glm::mat4(1.0f),
-                                                glm::vec3(wx, wy - treeBaseOffset, wz));
-            treeModel = glm::scale(treeModel, glm::vec3(1.5f));
-            depthShader.setMat4("model", treeModel);
-            tree.Draw(depthShader);
-        }
-        for (const glm::vec2& pos : lampPositions) {
-            float lx = pos.x;
-            float lz = pos.y;
-            float ly = lodTerrain.getHeightAt(lx, lz);
-
-            // translate so the lamp sits on the terrain
-            glm::mat4 lampM = glm::translate(glm::mat4(1.0f),
-                                                glm::vec3(lx, ly, lz));
-
-            lampM = glm::scale(lampM, glm::vec3(1.5f));
-            lampShader.setMat4("model", lampM);
-            lamp.Draw(lampShader);
-        }
-
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        
-
-        //
-        // 1) REFLECTION PASS
-        //
-        water.BindReflectionFrameBuffer();
-        glEnable(GL_CLIP_DISTANCE0);
-        // flip camera over water
-        float d = 2.0f * (camera.Position.y - WATER_HEIGHT);
-        camera.Position.y -= d;
-        camera.Pitch = -camera.Pitch;
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glm::vec4 clipPlaneR = glm::vec4(0, 1, 0, -WATER_HEIGHT + 0.8);
-
-        // 1a) terrain
-        // — bind terrain shader —
-        terrainShader.use();
-        
-
-        terrainShader.setInt("numSpotLights", (int)lampLights.size());
-        for(int i=0; i<lampLights.size(); ++i){
-            lampLights[i].ApplyToShader(terrainShader, "spotLights[" + std::to_string(i) + "]");
-        }
-        // textures
-        terrainShader.setInt("albedoMap",   0);
-        terrainShader.setInt("normalMap",   1);
-        terrainShader.setInt("shadowMap", 5);
-        terrainShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        // lighting
-        terrainShader.setVec3("lightDir", glm::normalize(-lightPos));
-        terrainShader.setVec3("lightColor", lightColor);
-        terrainShader.setFloat("ambientStrength", ambientStrength);
-        terrainShader.setVec3("viewPos",    camera.Position);
-        terrainShader.setFloat("dayFactor", dayFactor);
-        terrainShader.setBool("shadowsEnabled", lightPos.y > 0.0f);
-        // fog
-        terrainShader.setFloat("fogStart", fogStart);
-        terrainShader.setFloat("fogEnd",   fogEnd);
-        terrainShader.setVec3 ("fogColor", fogColor);
-
-        // water tint
-        terrainShader.setFloat("waterHeight", WATER_HEIGHT);
-        terrainShader.setFloat("maxDepth",     25.0f);
-        terrainShader.setVec3 ("shallowColor", glm::vec3(0.0f,0.25f,0.4f));
-        terrainShader.setVec3 ("deepColor",    glm::vec3(0.0f,0.05f,0.2f));
-
-        // transforms + clip
-        glm::mat4 model = glm::mat4(1.0f);
-        terrainShader.setMat4("model",      model);
-        terrainShader.setMat4("view",       view);
-        terrainShader.setMat4("projection", proj);
-        terrainShader.setVec4("clipPlane",  clipPlaneR);
-
-        // tiling scale
-        terrainShader.setFloat("worldScale", worldSize);
-
-        // draw
-        lodTerrain.Draw(camera.Position);
-
-
-        treeShader.use();
-        treeShader.setMat4("view",       view);
-        treeShader.setMat4("projection", proj);
-        treeShader.setVec3("lightPos",   lightPos);
-        treeShader.setVec3("viewPos",    camera.Position);
-        treeShader.setVec3("lightColor", lightColor);
-        treeShader.setFloat("fogStart", fogStart);
-        treeShader.setFloat("fogEnd",   fogEnd);
-        treeShader.setVec3("fogColor",  fogColor);
-        treeShader.setInt("shadowMap", 5);
-        treeShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        for (const glm::vec2& pos : treePositions) {
-            float wx = pos.x;
-            float wz = pos.y;
-            float wy = lodTerrain.getHeightAt(wx, wz);
-
-            glm::mat4 treeModel = glm::mat4(1.0f);
-            // Dịch origin của cây đến y = wy – treeBaseOffset
-            treeModel = glm::translate(treeModel,
-                                       glm::vec3(wx, wy - treeBaseOffset, wz));
-            // Scale cây (nếu muốn)
-            treeModel = glm::scale(treeModel, glm::vec3(1.5f));
-
-            treeShader.setMat4("model", treeModel);
-            tree.Draw(treeShader);
-        }
-
-
-        lampShader.use();
-        lampShader.setInt("numSpotLights", (int)lampLights.size());
-        for(int i=0; i<lampLights.size(); ++i){
-            lampLights[i].ApplyToShader(lampShader, "spotLights[" + std::to_string(i) + "]");
+            CAMERA_NEAR, CAMERA_FAR);
+        float fovY = glm::radians(camera.Zoom);
+        // the camera mirrored in the water plane, for the reflection pass
+        glm::mat4 reflView = camera.GetReflectionViewMatrix(WATER_HEIGHT);
+        glm::mat4 reflViewProj = proj * reflView;
+        glm::vec3 reflPos(camera.Position.x, 2.0f * WATER_HEIGHT - camera.Position.y, camera.Position.z);
+
+        shadows.update(view, fovY, float(SCR_WIDTH) / SCR_HEIGHT, CAMERA_NEAR,
+                       std::min(fogEnd, SHADOW_DISTANCE), sunDir, lightPos.y > 0.0f, lodTerrain);
+
+        // per-frame shared uniforms
+        FrameBlock frame{};
+        shadows.fill(frame);
+        frame.lightPos         = lightPos;
+        frame.dayFactor        = dayFactor;
+        frame.lightDir         = glm::normalize(-lightPos);
+        frame.ambientStrength  = ambientStrength;
+        frame.lightColor       = lightColor;
+        frame.shadowsEnabled   = lightPos.y > 0.0f;
+        frame.shallowColor     = glm::vec3(0.0f,0.25f,0.4f);
+        frame.waterHeight      = WATER_HEIGHT;
+        frame.deepColor        = glm::vec3(0.0f,0.05f,0.2f);
+        frame.maxDepth         = 25.0f;
+        frame.fogColor         = fogColor;
+        frame.fogStart         = fogStart;
+        frame.fogEnd           = fogEnd;
+        frameUniforms.update(frame);
+
+
+
+        // visible instances per pass; past fogEnd objects are pure fog colour
+        Frustum reflFrustum(reflViewProj);
+        Frustum viewFrustum = camera.GetFrustum(proj);
+        for (int c = 0; c < kShadowCascades; ++c) {
+            if (!shadows.needsRender(c)) continue;
+            Frustum cascadeFrustum(shadows.matrix(c));
+            placement.trees().cull(cascadeFrustum, shadowVisible[c].trees);
+            placement.lamps().cull(cascadeFrustum, shadowVisible[c].lamps);
         }
-        lampShader.setMat4("view",       view);
-        lampShader.setMat4("projection", proj);
-        lampShader.setVec3("lightPos",   lightPos);
-        lampShader.setVec3("viewPos",    camera.Position);
-        lampShader.setVec3("lightColor", lightColor);
-        lampShader.setFloat("fogStart", fogStart);
-        lampShader.setFloat("fogEnd",   fogEnd);
-        lampShader.setVec3("fogColor",  fogColor);
-        lampShader.setInt("shadowMap", 5);
-        lampShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        for (const glm::vec2& pos : lampPositions) {
-                float lx = pos.x;
-                float lz = pos.y;
-                float ly = lodTerrain.getHeightAt(lx, lz);
-
-                // translate so the lamp sits on the terrain
-                glm::mat4 lampM = glm::translate(glm::mat4(1.0f),
-                                                    glm::vec3(lx, ly, lz));
-                // if your lamp model’s origin is at its base, you’re done.
-                // otherwise you might need to pull it up by half its height:
-                // lampM = glm::translate(lampM, glm::vec3(0, lampBaseOffset, 0));
-
-                lampM = glm::scale(lampM, glm::vec3(1.5f));  // optional scale
-                lampShader.setMat4("model", lampM);
-                lamp.Draw(lampShader);
-        }
-        sphereShader.use();
-        sphereShader.setMat4("view",       view);
-        sphereShader.setMat4("projection", proj);
-        sphereShader.setVec3("color", glm::vec3(1.0f, 0.85f, 0.6f));
-        std::vector<glm::vec3> bulbWorldPositions;
-        bulbWorldPositions.reserve(lampPositions.size() * bulbLocals.size());
-
-        for (auto const& pos : lampPositions) {
-            float lx = pos.x, lz = pos.y;
-            float ly = lodTerrain.getHeightAt(lx, lz);
-
-            // same matrix you use to draw the lamp model itself
-            glm::mat4 lampM = glm::translate(glm::mat4(1.0f),
-                                            glm::vec3(lx, ly, lz));
-            lampM = glm::scale(lampM, glm::vec3(1.5f));  // your chosen scale
-
-        // transform each local bulb into world
-            for (auto const& local : bulbLocals) {
-                bulbWorldPositions.push_back(glm::vec3(lampM * local));
-            }
-        }
-
-        for (auto const & bulbPos : bulbWorldPositions) {
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), bulbPos)
-                        * glm::scale    (glm::mat4(1.0f), glm::vec3(0.1f));  // tweak sphere size
-            sphereShader.setMat4("model", M);
-            lightSphere.draw();
-        }
-
-        litShader.use();
-        litShader.setMat4("view", camera.GetViewMatrix());
-        litShader.setMat4("projection", proj);
-        litShader.setVec3("lightDir", glm::normalize(lightPos));
-        litShader.setVec3("lightPos", lightPos);
-        litShader.setVec3("viewPos", camera.Position);
-        litShader.setVec3("lightColor", lightColor);
-        
-        lightViz.Draw(proj, view, lightPos, sphereScale);
-
-
-        // 1c) skybox
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        skyboxShader.setMat4("view", glm::mat4(glm::mat3(camera.GetViewMatrix())));
-        skyboxShader.setMat4("projection", proj);
-        skybox.render();
-        glDepthFunc(GL_LESS);
-
-        // restore camera
-        camera.Position.y += d;
-        camera.Pitch = -camera.Pitch;
-        water.UnbindFrameBuffer(SCR_WIDTH, SCR_HEIGHT);
-        glDisable(GL_CLIP_DISTANCE0);
-
-        //
-        // 2) REFRACTION
-        //
-        glm::vec4 clipPlaneF = glm::vec4(0, -1, 0, WATER_HEIGHT + 0.8);
-        water.BindRefractionFrameBuffer();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        // draw only what's under water:
-        glEnable(GL_CLIP_DISTANCE0);
-        // — bind terrain shader —
-        terrainShader.use();
-
-
-        terrainShader.setInt("numSpotLights", (int)lampLights.size());
-        for(int i=0; i<lampLights.size(); ++i){
-            lampLights[i].ApplyToShader(terrainShader, "spotLights[" + std::to_string(i) + "]");
-        }
-        // textures
-        terrainShader.setInt("albedoMap",   0);
-        terrainShader.setInt("normalMap",   1);
-
-        // lighting
-        terrainShader.setVec3("lightDir", glm::normalize(-lightPos));
-        terrainShader.setVec3("lightColor", lightColor);
-        terrainShader.setFloat("ambientStrength", ambientStrength);
-        terrainShader.setVec3("viewPos",    camera.Position);
-        terrainShader.setFloat("dayFactor", dayFactor);
-        terrainShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        terrainShader.setBool("shadowsEnabled", lightPos.y > 0.0f);
-
-        // fog
-        terrainShader.setFloat("fogStart", fogStart);
-        terrainShader.setFloat("fogEnd",   fogEnd);
-        terrainShader.setVec3 ("fogColor", fogColor);
-
-        // water tint
-        terrainShader.setFloat("waterHeight", WATER_HEIGHT);
-        terrainShader.setFloat("maxDepth",     25.0f);
-        terrainShader.setVec3 ("shallowColor", glm::vec3(0.0f,0.25f,0.4f));
-        terrainShader.setVec3 ("deepColor",    glm::vec3(0.0f,0.05f,0.2f));
-
-        // transforms + clip
-        terrainShader.setMat4("model",      model);
-        terrainShader.setMat4("view",       view);
-        terrainShader.setMat4("projection", proj);
-        terrainShader.setVec4("clipPlane",  clipPlaneF);
-
-        // tiling scale
-        terrainShader.setFloat("worldScale", worldSize);
-
-        // draw
-        lodTerrain.Draw(camera.Position);
-
-
-        glDisable(GL_CLIP_DISTANCE0);
-        water.UnbindFrameBuffer(SCR_WIDTH, SCR_HEIGHT);
-
-        //
-        // 3) MAIN ONSCREEN PASS
-        //
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // 3a) terrain (no clipping)
-
-        // — bind terrain shader —
-        terrainShader.use();
-        terrainShader.setInt("numSpotLights", (int)lampLights.size());
-        for(int i=0; i<lampLights.size(); ++i){
-            lampLights[i].ApplyToShader(terrainShader, "spotLights[" + std::to_string(i) + "]");
+        placement.trees().cull(reflFrustum, reflectionVisible.trees, reflPos, fogEnd);
+        placement.lamps().cull(reflFrustum, reflectionVisible.lamps, reflPos, fogEnd);
+        placement.bulbs().cull(reflFrustum, reflectionVisible.bulbs, reflPos, fogEnd);
+        placement.trees().cull(viewFrustum, mainVisible.trees, camera.Position, fogEnd);
+        placement.lamps().cull(viewFrustum, mainVisible.lamps, camera.Position, fogEnd);
+        placement.bulbs().cull(viewFrustum, mainVisible.bulbs, camera.Position, fogEnd);
+
+        // each camera gets its own light assignment: the froxels follow the
+        // view, and the mirrored one only matters while the water is on screen
+        const BoundingBox waterBox = water.getBounds();
+        const bool waterVisible = viewFrustum.intersects(waterBox.min, waterBox.max);
+        lightClusters.update(placement.lights(), view, proj);
+        if (waterVisible)
+            reflectionClusters.update(placement.lights(), reflView, proj);
+
+        // — passes —
+        // unclipped passes still upload clipPlaneR; gl_ClipDistance is ignored there
+        const glm::vec4 clipPlaneR = glm::vec4(0, 1, 0, -WATER_HEIGHT + 0.8);
+        const glm::vec4 clipPlaneF = glm::vec4(0, -1, 0, WATER_HEIGHT + 0.8);
+        const RenderGraph::Camera mainCamera{view, proj, camera.Position};
+        const RenderGraph::Camera mirrorCamera{reflView, proj, reflPos};
+
+        // terrain, then (if given) the placed objects, light markers and sky,
+        // as seen by the pass's camera
+        auto drawScene = [&](const RenderGraph::Pass& pass, LightClusters& clusters,
+                             const PassInstances* objects) {
+            const RenderGraph::Camera& cam = pass.camera;
+            clusters.bind();
+            shadows.bind();
+            terrainShader.use();
+            terrainShader.setVec4("clipPlane", pass.clip ? pass.clipPlane : clipPlaneR);
+            lodTerrain.Draw(terrainShader, cam.position, cam.projection * cam.view, fovY, SCR_HEIGHT);
+            // terrain, clusters and shadows bind outside glState
+            glState.invalidate();
+            if (!objects) return;
+
+            glState.useProgram(sphereShader.ID);
+            sphereShader.setMat4("view",       cam.view);
+            sphereShader.setMat4("projection", cam.projection);
+            sphereShader.setVec3("color", glm::vec3(1.0f, 0.85f, 0.6f));
+
+            tree.Submit(drawQueue, treeShader, objects->trees.buffer);
+            lamp.Submit(drawQueue, lampShader, objects->lamps.buffer);
+            lightSphere.submitInstanced(drawQueue, sphereShader, objects->bulbs.buffer);
+            drawQueue.submit(glState);
+
+            lightViz.Draw(cam.projection, cam.view, lightPos, sphereScale);
+
+            glDepthFunc(GL_LEQUAL);
+            skyboxShader.use();
+            skyboxShader.setMat4("view", glm::mat4(glm::mat3(cam.view)));
+            skyboxShader.setMat4("projection", cam.projection);
+            skybox.render();
+            glDepthFunc(GL_LESS);
+            glState.invalidate();   // light markers and sky too
+        };
+
+        graph.beginFrame();
+
+        for (int c = 0; c < kShadowCascades; ++c) {
+            graph.addPass("shadow " + std::to_string(c), shadowTargets[c], [&, c](const RenderGraph::Pass&) {
+                const glm::mat4& lightMatrix = shadows.matrix(c);
+                terrainDepthShader.use();
+                terrainDepthShader.setMat4("lightSpaceMatrix", lightMatrix);
+                // LOD follows the camera, culling follows the cascade
+                lodTerrain.Draw(terrainDepthShader, camera.Position, lightMatrix, fovY, SCR_HEIGHT);
+                glState.invalidate();
+
+                glState.useProgram(depthShader.ID);
+                depthShader.setMat4("lightSpaceMatrix", lightMatrix);
+                tree.Submit(drawQueue, depthShader, shadowVisible[c].trees.buffer, /*textured=*/false);
+                lamp.Submit(drawQueue, depthShader, shadowVisible[c].lamps.buffer, /*textured=*/false);
+                drawQueue.submit(glState);
+            }).enabledIf(shadows.needsRender(c));   // cached otherwise
+
+            graph.addPass("shadow esm " + std::to_string(c), esmTargets[c], [&, c](const RenderGraph::Pass&) {
+                shadows.resolveEsm(c);
+                glState.invalidate();
+            }).reading(shadowTargets[c])
+              .enabledIf(shadows.needsRender(c) && shadows.filter() == ShadowCascades::Filter::Esm);
         }
 
-        // textures
-        terrainShader.setInt("albedoMap",   0);
-        terrainShader.setInt("normalMap",   1);
-        terrainShader.setInt("shadowMap", 5);
-        terrainShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        // lighting
-        terrainShader.setVec3("lightDir", glm::normalize(lightPos));
-        terrainShader.setVec3("lightColor", lightColor);
-        terrainShader.setFloat("ambientStrength", ambientStrength);
-        terrainShader.setVec3("viewPos",    camera.Position);
-        terrainShader.setFloat("dayFactor", dayFactor);
-        terrainShader.setBool("shadowsEnabled", lightPos.y > 0.0f);
-
-        // fog
-        terrainShader.setFloat("fogStart", fogStart);
-        terrainShader.setFloat("fogEnd",   fogEnd);
-        terrainShader.setVec3 ("fogColor", fogColor);
-
-        // water tint
-        terrainShader.setFloat("waterHeight", WATER_HEIGHT);
-        terrainShader.setFloat("maxDepth",     25.0f);
-        terrainShader.setVec3 ("shallowColor", glm::vec3(0.0f,0.25f,0.4f));
-        terrainShader.setVec3 ("deepColor",    glm::vec3(0.0f,0.05f,0.2f));
-
-        // transforms + clip
-        terrainShader.setMat4("model",      model);
-        terrainShader.setMat4("view",       view);
-        terrainShader.setMat4("projection", proj);
-        terrainShader.setVec4("clipPlane",  clipPlaneR);
-
-        // tiling scale
-        terrainShader.setFloat("worldScale", worldSize);
-
-        // draw
-        lodTerrain.Draw(camera.Position);
-
-
-        lampShader.use();
-        lampShader.use();
-        lampShader.setInt("numSpotLights", (int)lampLights.size());
-        for(int i=0; i<lampLights.size(); ++i){
-            lampLights[i].ApplyToShader(lampShader, "spotLights[" + std::to_string(i) + "]");
-        }
-        lampShader.setMat4("view",       view);
-        lampShader.setMat4("projection", proj);
-        lampShader.setVec3("lightPos",   lightPos);
-        lampShader.setVec3("viewPos",    camera.Position);
-        lampShader.setVec3("lightColor", lightColor);
-        lampShader.setFloat("fogStart", fogStart);
-        lampShader.setFloat("fogEnd",   fogEnd);
-        lampShader.setVec3("fogColor",  fogColor);
-        lampShader.setInt("shadowMap", 5);
-        lampShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        for (const glm::vec2& pos : lampPositions) {
-                float lx = pos.x;
-                float lz = pos.y;
-                float ly = lodTerrain.getHeightAt(lx, lz);
-
-                // translate so the lamp sits on the terrain
-                glm::mat4 lampM = glm::translate(glm::mat4(1.0f),
-                                                    glm::vec3(lx, ly, lz));
-                // if your lamp model’s origin is at its base, you’re done.
-                // otherwise you might need to pull it up by half its height:
-                // lampM = glm::translate(lampM, glm::vec3(0, lampBaseOffset, 0));
-
-                lampM = glm::scale(lampM, glm::vec3(1.5f));  // optional scale
-                lampShader.setMat4("model", lampM);
-                lamp.Draw(lampShader);
-        }
-        sphereShader.use();
-        sphereShader.setMat4("view",       view);
-        sphereShader.setMat4("projection", proj);
-        sphereShader.setVec3("color", glm::vec3(1.0f, 0.85f, 0.6f));
-        bulbWorldPositions.reserve(lampPositions.size() * bulbLocals.size());
-
-        for (auto const& pos : lampPositions) {
-            float lx = pos.x, lz = pos.y;
-            float ly = lodTerrain.getHeightAt(lx, lz);
-
-            // same matrix you use to draw the lamp model itself
-            glm::mat4 lampM = glm::translate(glm::mat4(1.0f),
-                                            glm::vec3(lx, ly, lz));
-            lampM = glm::scale(lampM, glm::vec3(1.5f));  // your chosen scale
-
-        // transform each local bulb into world
-            for (auto const& local : bulbLocals) {
-                bulbWorldPositions.push_back(glm::vec3(lampM * local));
-            }
-        }
-        for (auto const & bulbPos : bulbWorldPositions) {
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), bulbPos)
-                        * glm::scale    (glm::mat4(1.0f), glm::vec3(0.1f));  // tweak sphere size
-            sphereShader.setMat4("model", M);
-            lightSphere.draw();
-        }
-        treeShader.use();
-        treeShader.setMat4("view",       view);
-        treeShader.setMat4("projection", proj);
-        treeShader.setVec3("lightPos",   lightPos);
-        treeShader.setVec3("viewPos",    camera.Position);
-        treeShader.setVec3("lightColor", lightColor);
-        treeShader.setFloat("fogStart", fogStart);
-        treeShader.setFloat("fogEnd",   fogEnd);
-        treeShader.setVec3("fogColor",  fogColor);
-        treeShader.setInt("shadowMap", 5);
-        treeShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        for (const glm::vec2& pos : treePositions) {
-            float wx = pos.x;
-            float wz = pos.y;
-            float wy = lodTerrain.getHeightAt(wx, wz);
-
-            glm::mat4 treeModel = glm::mat4(1.0f);
-            // Dịch origin của cây đến y = wy – treeBaseOffset
-            treeModel = glm::translate(treeModel,
-                                       glm::vec3(wx, wy - treeBaseOffset, wz));
-            // Scale cây (nếu muốn)
-            treeModel = glm::scale(treeModel, glm::vec3(1.5f));
-
-            treeShader.setMat4("model", treeModel);
-            tree.Draw(treeShader);
+        // what's above the water, seen from the camera mirrored in it
+        RenderGraph::Pass& reflection = graph.addPass("reflection", reflectionTarget, [&](const RenderGraph::Pass& p) {
+            drawScene(p, reflectionClusters, &reflectionVisible);
+        }).withCamera(mirrorCamera).clippedBy(clipPlaneR);
+
+        // what's under the water: terrain only
+        RenderGraph::Pass& refraction = graph.addPass("refraction", refractionTarget, [&](const RenderGraph::Pass& p) {
+            drawScene(p, lightClusters, nullptr);
+        }).withCamera(mainCamera).clippedBy(clipPlaneF);
+
+        RenderGraph::Pass& scene = graph.addPass("scene", RenderGraph::kBackbuffer, [&](const RenderGraph::Pass& p) {
+            drawScene(p, lightClusters, &mainVisible);
+        }).withCamera(mainCamera);
+        for (int c = 0; c < kShadowCascades; ++c) {
+            RenderGraph::Target t = shadows.filter() == ShadowCascades::Filter::Esm ? esmTargets[c]
+                                                                                    : shadowTargets[c];
+            reflection.reading(t);
+            refraction.reading(t);
+            scene.reading(t);
         }
 
-
-        litShader.use(); // Use same shader as main pass
-        litShader.setMat4("view", camera.GetViewMatrix());
-        litShader.setMat4("projection", proj);
-        litShader.setVec3("lightDir", glm::normalize(-lightPos));
-        litShader.setVec3("lightPos", lightPos);
-        litShader.setVec3("viewPos", camera.Position);
-        litShader.setVec3("lightColor", lightColor);
-        lightViz.Draw(proj, view, lightPos, sphereScale);
-
-
-        // 3c) skybox
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        skyboxShader.setMat4("view", glm::mat4(glm::mat3(view)));
-        skyboxShader.setMat4("projection", proj);
-        skybox.render();
-        glDepthFunc(GL_LESS);
-
-        // 3d) water (blended on top)
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glDepthMask(GL_FALSE);
-
-        water.Draw(
-            glm::translate(glm::mat4(1.0f), glm::vec3(0, WATER_HEIGHT, 0)),
-            view,
-            proj,
-            camera.Position,
-            lightPos,
-            lightColor,
-            dudvMove,
-            skybox.getTextureID());
-
-        glDepthMask(GL_TRUE);
-        glDisable(GL_BLEND);
+        // blended on top; off-screen water takes reflection and refraction with it
+        graph.addPass("water", RenderGraph::kBackbuffer, [&](const RenderGraph::Pass&) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+            water.Draw(
+                glm::translate(glm::mat4(1.0f), glm::vec3(0, WATER_HEIGHT, 0)),
+                dudvMove,
+                skybox.getTextureID());
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+            glState.invalidate();
+        }).reading(reflectionTarget).reading(refractionTarget).withCamera(mainCamera)
+          .enabledIf(waterVisible);
+
+        glState.resetStats();
+        graph.execute();
 
         // — ImGui overlay —
         ImGui_ImplOpenGL3_NewFrame();
@@ -902,6 +567,15 @@ int main()
                     camera.Pitch, camera.Yaw);
         ImGui::Separator();
         ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+        ImGui::Text("Terrain triangles: %zu", lodTerrain.lastTriangleCount());
+        ImGui::Text("Terrain tiles: %zu (+%zu building)", lodTerrain.tileCount(), lodTerrain.pendingCount());
+        ImGui::Text("Textures: %zu", assets.textureCount());
+        ImGui::Text("Passes: %zu of %zu", graph.executedPasses().size(), graph.passCount());
+        ImGui::Text("Shadow cascades redrawn: %d of %d", shadows.renderCount(), kShadowCascades);
+        bool softShadows = shadows.filter() == ShadowCascades::Filter::Esm;
+        if (ImGui::Checkbox("Soft shadows (ESM)", &softShadows))
+            shadows.setFilter(softShadows ? ShadowCascades::Filter::Esm : ShadowCascades::Filter::Pcf);
+        ImGui::Text("Queued binds: %u issued, %u skipped", glState.stats().issued, glState.stats().skipped);
 
         // 5) Debug FBOs, shadow
         ImGui::Separator();           
@@ -910,9 +584,9 @@ int main()
         if(showDebug){
             if(ImGui::Begin("Debug section", &showDebug)){
                 ImGui::Separator();
-                ImGui::Text("Shadow Map Debug");
-                ImGui::Image((ImTextureID)(uintptr_t)depthMap, ImVec2(256,256),
-                            ImVec2(0,1), ImVec2(1,0));
+                ImGui::Text("Shadow Cascades (%dx%d each):", shadows.resolution(), shadows.resolution());
+                for (int c = 0; c < kShadowCascades; ++c)
+                    ImGui::Text("  %d: up to %.1f", c, shadows.splitDistance(c));
                 
                 ImGui::Separator();
                 ImGui::Text("Debug FBO Textures:");
@@ -931,6 +605,7 @@ int main()
         }
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        glState.invalidate();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -1,13 +1,15 @@
 // grass.cpp
 #include "grass.h"
-#include "../lib/stb_image.h"
 #include <iostream>
 
-Grass::Grass(const char* texturePath,
+Grass::Grass(AssetLoader& assets,
+             const char* texturePath,
              const std::vector<glm::vec3>& vegetationPositions)
     : positions(vegetationPositions)
 {
-    textureID = loadTexture(texturePath);
+    TextureOptions options;
+    options.clampIfAlpha = true;   // clamp edges for alpha
+    texture = assets.texture(texturePath, options);
     setupMesh();
 }
 
@@ -59,7 +61,7 @@ void Grass::Draw(unsigned int shaderID,
 
     // bind texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glBindTexture(GL_TEXTURE_2D, texture.id());
 
     // pivot offset (center of quad)
     const glm::vec3 pivot(0.5f, 0.0f, 0.0f);
@@ -87,26 +89,3 @@ void Grass::Draw(unsigned int shaderID,
     }
     glBindVertexArray(0);
 }
-
-unsigned int Grass::loadTexture(const char* path)
-{
-    unsigned int ID;
-    glGenTextures(1, &ID);
-    int w,h,n;
-    unsigned char* data = stbi_load(path,&w,&h,&n,0);
-    if (!data) {
-        std::cerr<<"Failed to load grass texture "<<path<<"\n";
-        return 0;
-    }
-    GLenum fmt = (n==4?GL_RGBA:(n==3?GL_RGB:GL_RED));
-    glBindTexture(GL_TEXTURE_2D, ID);
-    glTexImage2D(GL_TEXTURE_2D,0,fmt,w,h,0,fmt,GL_UNSIGNED_BYTE,data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    // clamp edges for alpha
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,fmt==GL_RGBA?GL_CLAMP_TO_EDGE:GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,fmt==GL_RGBA?GL_CLAMP_TO_EDGE:GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    stbi_image_free(data);
-    return ID;
-}
@@ -7,11 +7,12 @@
 #include <string>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "../ultis/assetLoader.h"
 
 class Grass
 {
 public:
-    Grass(const char* texturePath, const std::vector<glm::vec3>& vegetationPositions);
+    Grass(AssetLoader& assets, const char* texturePath, const std::vector<glm::vec3>& vegetationPositions);
 
     /// Draws all grass blades.  
     /// @param shaderID  the GLSL program ID (must already have set view, projection, texture1)  
@@ -24,10 +25,9 @@ public:
 
 private:
     void setupMesh();
-    unsigned int loadTexture(const char* path);
 
     unsigned int VAO, VBO;
-    unsigned int textureID;
+    TextureHandle texture;
     std::vector<glm::vec3> positions;
 };
 #endif
@@ -0,0 +1,215 @@
+#include "lightClusters.h"
+#include <algorithm>
+#include <cmath>
+
+// lights are cut off where they fall below 1/256 of their peak: invisible in
+// an 8-bit target, and what bounds how many froxels a lamp lands in
+static const float kLightCutoff = 1.0f / 256.0f;
+static const std::size_t kMaxLights = 0xFFFF;   // 16-bit indices
+
+// distance at which the light's attenuation drops to kLightCutoff
+static float spotRange(const SpotLight& l) {
+    float peak = std::max(std::max(l.Diffuse.x, l.Diffuse.y), l.Diffuse.z);
+    peak = std::max(peak, std::max(std::max(l.Specular.x, l.Specular.y), l.Specular.z));
+    float c = l.Constant - peak / kLightCutoff;      // q r^2 + l r + c = 0
+    if (c >= 0.0f) return 0.0f;
+    if (l.Quadratic > 1e-6f)
+        return (-l.Linear + std::sqrt(l.Linear*l.Linear - 4.0f*l.Quadratic*c)) / (2.0f*l.Quadratic);
+    if (l.Linear > 1e-6f) return -c / l.Linear;
+    return 1e30f;
+}
+
+static void setupBufferTexture(GLuint& buffer, GLuint& tex, GLenum format) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// orphan and refill; never zero-sized so the texture stays valid
+static void uploadBuffer(GLuint buffer, const void* data, std::size_t bytes) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(bytes, 16), nullptr, GL_STREAM_DRAW);
+    if (bytes) glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::LightClusters(float zNear_, float zFar_)
+    : zNear(zNear_), zFar(zFar_), froxelProj(0.0f)
+{
+    float logRatio = std::log(zFar / zNear);
+    sliceScale = float(kSlices) / logRatio;
+    sliceBias  = float(kSlices) * std::log(zNear) / logRatio;
+    for (int z = 0; z <= kSlices; ++z)
+        sliceNear[z] = zNear * std::pow(zFar / zNear, float(z) / kSlices);
+
+    grid.resize(2 * kClusterCount);
+    cursor.resize(kClusterCount);
+    setupBufferTexture(lightBuffer, lightTex, GL_RGBA32F);
+    setupBufferTexture(gridBuffer,  gridTex,  GL_RG32UI);
+    setupBufferTexture(indexBuffer, indexTex, GL_R16UI);
+}
+
+LightClusters::~LightClusters() {
+    GLuint buffers[] = { lightBuffer, gridBuffer, indexBuffer };
+    GLuint textures[] = { lightTex, gridTex, indexTex };
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+}
+
+int LightClusters::sliceOf(float depth) const {
+    int s = int(std::floor(std::log(std::max(depth, zNear)) * sliceScale - sliceBias));
+    return std::min(std::max(s, 0), kSlices - 1);
+}
+
+void LightClusters::buildFroxels(const glm::mat4& proj) {
+    froxelProj = proj;
+    glm::mat4 inv = glm::inverse(proj);
+
+    // view-space direction through every tile corner, scaled to z = -1
+    std::vector<glm::vec3> rays((kTilesX + 1) * (kTilesY + 1));
+    for (int y = 0; y <= kTilesY; ++y) {
+        for (int x = 0; x <= kTilesX; ++x) {
+            glm::vec4 p = inv * glm::vec4(2.0f*x/kTilesX - 1.0f, 2.0f*y/kTilesY - 1.0f, -1.0f, 1.0f);
+            glm::vec3 v = glm::vec3(p) / p.w;
+            rays[y*(kTilesX + 1) + x] = v / -v.z;
+        }
+    }
+
+    froxels.resize(kClusterCount);
+    for (int z = 0; z < kSlices; ++z) {
+        float d0 = sliceNear[z], d1 = sliceNear[z + 1];
+        for (int y = 0; y < kTilesY; ++y) {
+            for (int x = 0; x < kTilesX; ++x) {
+                Froxel& f = froxels[(z*kTilesY + y)*kTilesX + x];
+                f.lo = glm::vec3(1e30f); f.hi = glm::vec3(-1e30f);
+                for (int c = 0; c < 4; ++c) {
+                    const glm::vec3& r = rays[(y + (c >> 1))*(kTilesX + 1) + x + (c & 1)];
+                    f.lo = glm::min(f.lo, glm::min(r*d0, r*d1));
+                    f.hi = glm::max(f.hi, glm::max(r*d0, r*d1));
+                }
+                f.center = 0.5f*(f.lo + f.hi);
+                f.radius = 0.5f*glm::length(f.hi - f.lo);
+            }
+        }
+    }
+}
+
+void LightClusters::update(const std::vector<SpotLight>& lights,
+                           const glm::mat4& view, const glm::mat4& proj) {
+    if (proj != froxelProj) buildFroxels(proj);
+    numLights = std::min(lights.size(), kMaxLights);
+
+    // 5 texels per light:
+    //   position, Constant | direction, Linear | ambient, Quadratic
+    //   diffuse, CutOff    | specular, OuterCutOff
+    lightData.resize(numLights * 5);
+    for (std::size_t i = 0; i < numLights; ++i) {
+        const SpotLight& l = lights[i];
+        glm::vec4* t = &lightData[i * 5];
+        t[0] = glm::vec4(l.Position, l.Constant);
+        t[1] = glm::vec4(glm::normalize(l.Direction), l.Linear);
+        t[2] = glm::vec4(l.Ambient, l.Quadratic);
+        t[3] = glm::vec4(l.Diffuse, l.CutOff);
+        t[4] = glm::vec4(l.Specular, l.OuterCutOff);
+    }
+
+    std::fill(grid.begin(), grid.end(), 0u);
+    pairs.clear();
+    for (std::size_t i = 0; i < numLights; ++i) {
+        const SpotLight& l = lights[i];
+        float range = spotRange(l);
+        if (range <= 0.0f) continue;
+
+        // cone in view space
+        glm::vec3 apex = glm::vec3(view * glm::vec4(l.Position, 1.0f));
+        glm::vec3 axis = glm::normalize(glm::vec3(view * glm::vec4(l.Direction, 0.0f)));
+        float cosA = glm::clamp(l.OuterCutOff, 0.0f, 1.0f);
+        float sinA = std::sqrt(1.0f - cosA*cosA);
+
+        // tightest sphere around the cone
+        glm::vec3 center; float radius;
+        if (cosA < 0.7071f) { center = apex + axis*(range*cosA);        radius = range*sinA; }
+        else                { center = apex + axis*(range/(2.0f*cosA)); radius = range/(2.0f*cosA); }
+
+        float dMin = -center.z - radius, dMax = -center.z + radius;
+        if (dMax < zNear || dMin > zFar) continue;
+        int z0 = sliceOf(dMin), z1 = sliceOf(dMax);
+
+        for (int z = z0; z <= z1; ++z) {
+            // screen tiles: project the sphere's box, clipped to this slice's
+            // depth range; all tiles when it reaches the near plane
+            float da = std::max(dMin, sliceNear[z]), db = std::min(dMax, sliceNear[z + 1]);
+            int x0 = 0, x1 = kTilesX - 1, y0 = 0, y1 = kTilesY - 1;
+            if (da > zNear) {
+                glm::vec2 lo(1e30f), hi(-1e30f);
+                for (int c = 0; c < 8; ++c) {
+                    glm::vec3 p(center.x + (c & 1 ? radius : -radius),
+                                center.y + (c & 2 ? radius : -radius),
+                                c & 4 ? -db : -da);
+                    glm::vec4 clip = proj * glm::vec4(p, 1.0f);
+                    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                    lo = glm::min(lo, ndc); hi = glm::max(hi, ndc);
+                }
+                if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) continue;
+                x0 = std::max(int((lo.x*0.5f + 0.5f)*kTilesX), 0);
+                x1 = std::min(int((hi.x*0.5f + 0.5f)*kTilesX), kTilesX - 1);
+                y0 = std::max(int((lo.y*0.5f + 0.5f)*kTilesY), 0);
+                y1 = std::min(int((hi.y*0.5f + 0.5f)*kTilesY), kTilesY - 1);
+            }
+
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    int idx = (z*kTilesY + y)*kTilesX + x;
+                    const Froxel& f = froxels[idx];
+                    // cone's sphere against the froxel box, then the froxel's
+                    // sphere against the cone itself
+                    glm::vec3 q = glm::clamp(center, f.lo, f.hi) - center;
+                    if (glm::dot(q, q) > radius*radius) continue;
+                    glm::vec3 v = f.center - apex;
+                    float along = glm::dot(v, axis);
+                    float side = std::sqrt(std::max(glm::dot(v, v) - along*along, 0.0f));
+                    if (cosA*side - along*sinA > f.radius || along > range + f.radius || along < -f.radius)
+                        continue;
+
+                    pairs.push_back(std::uint32_t(idx) << 16 | std::uint32_t(i));
+                    ++grid[2*idx + 1];
+                }
+            }
+        }
+    }
+
+    // group the light indices by cluster (counting sort)
+    std::uint32_t offset = 0;
+    for (int c = 0; c < kClusterCount; ++c) {
+        grid[2*c] = cursor[c] = offset;
+        offset += grid[2*c + 1];
+    }
+    indices.resize(pairs.size());
+    for (std::uint32_t p : pairs)
+        indices[cursor[p >> 16]++] = std::uint16_t(p & 0xFFFF);
+
+    uploadBuffer(lightBuffer, lightData.data(), lightData.size() * sizeof(glm::vec4));
+    uploadBuffer(gridBuffer,  grid.data(),      grid.size() * sizeof(std::uint32_t));
+    uploadBuffer(indexBuffer, indices.data(),   indices.size() * sizeof(std::uint16_t));
+}
+
+void LightClusters::bind() const {
+    glActiveTexture(GL_TEXTURE0 + kLightUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTex);
+    glActiveTexture(GL_TEXTURE0 + kGridUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTex);
+    glActiveTexture(GL_TEXTURE0 + kIndexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTex);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::setSamplers(const Shader& shader) {
+    shader.setInt("spotLightData", kLightUnit);
+    shader.setInt("clusterGrid",   kGridUnit);
+    shader.setInt("clusterLights", kIndexUnit);
+}
@@ -0,0 +1,84 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "../lib/glad.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "spotLight.hpp"
+#include "../ultis/shaderReader.h"
+
+// Clustered forward lighting for spotlights.
+//
+// The view frustum is cut into kTilesX x kTilesY screen tiles and kSlices
+// exponential depth slices ("froxels"). Every frame the lights are packed into
+// one buffer and each light is assigned, on the CPU, to the froxels its cone
+// touches. Fragment shaders find their froxel and loop over that list only.
+//
+// Everything reaches the shaders as buffer textures (GL 3.3 has no SSBOs):
+//   spotLightData  RGBA32F, 5 texels per light (see packing in update())
+//   clusterGrid    RG32UI,  (first index, count) per froxel
+//   clusterLights  R16UI,   light indices, grouped by froxel
+// The grid size below is repeated in terrain.fs and lit.fs.
+class LightClusters {
+public:
+    static const int kTilesX = 16;
+    static const int kTilesY = 9;
+    static const int kSlices = 24;
+    static const int kClusterCount = kTilesX * kTilesY * kSlices;
+
+    // texture units the three buffers live on
+    static const int kLightUnit = 6;
+    static const int kGridUnit  = 7;
+    static const int kIndexUnit = 8;
+
+    // zNear/zFar: depth range the slices cover (the camera's clip planes)
+    LightClusters(float zNear, float zFar);
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // pack `lights` and assign them to the froxels of the camera (view, proj)
+    void update(const std::vector<SpotLight>& lights, const glm::mat4& view, const glm::mat4& proj);
+    // bind the buffers to their texture units
+    void bind() const;
+    // point a program's samplers at the units above
+    static void setSamplers(const Shader& shader);
+
+    // slice = log(viewDepth) * x - y, for the shaders (Camera block)
+    glm::vec2 depthParams() const { return glm::vec2(sliceScale, sliceBias); }
+
+    std::size_t lightCount() const { return numLights; }
+    std::size_t assignmentCount() const { return indices.size(); }
+
+private:
+    struct Froxel {
+        glm::vec3 lo, hi;         // view-space bounds
+        glm::vec3 center;         // and the sphere around them
+        float     radius;
+    };
+
+    void buildFroxels(const glm::mat4& proj);
+    int  sliceOf(float depth) const;
+
+    float zNear, zFar;
+    float sliceScale, sliceBias;
+    float sliceNear[kSlices + 1];     // view depth where each slice starts
+
+    glm::mat4           froxelProj;   // projection the froxel bounds were built for
+    std::vector<Froxel> froxels;
+
+    // CPU side of the buffers, reused every frame
+    std::vector<glm::vec4>     lightData;
+    std::vector<std::uint32_t> grid;       // 2 per cluster
+    std::vector<std::uint16_t> indices;
+    std::vector<std::uint32_t> pairs;      // cluster << 16 | light, in light order
+    std::vector<std::uint32_t> cursor;     // per-cluster write position while grouping
+    std::size_t                numLights = 0;
+
+    GLuint lightBuffer = 0, gridBuffer = 0, indexBuffer = 0;
+    GLuint lightTex = 0,    gridTex = 0,    indexTex = 0;
+};
+
+#endif // LIGHT_CLUSTERS_H
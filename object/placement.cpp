@@ -0,0 +1,118 @@
+#include "placement.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <numeric>
+#include <utility>
+
+static const float kTreeScale = 1.5f;
+static const float kLampScale = 1.5f;
+static const float kBulbScale = 0.1f;
+// bulbs sit below the lamp's top, spread either side of the post
+static const float kBulbDrop  = 1.7f;
+static const float kArmOffset = 1.8f;
+
+StaticPlacement::StaticPlacement(const BoundingBox& tree, const BoundingBox& lamp, const BoundingBox& bulb)
+    : treeBaseOffset(tree.min.y)
+    , treeSet(BoundingSphere::around(tree))
+    , lampSet(BoundingSphere::around(lamp))
+    , bulbSet(BoundingSphere::around(bulb))
+{
+    float lampTopY = lamp.max.y;
+    bulbLocal[0] = glm::vec4(0.0f, lampTopY - kBulbDrop,  kArmOffset, 1.0f);   // left
+    bulbLocal[1] = glm::vec4(0.0f, lampTopY - kBulbDrop, -kArmOffset, 1.0f);   // right
+}
+
+void StaticPlacement::place(std::vector<glm::vec2> trees_, std::vector<glm::vec2> lamps_) {
+    treePositions = std::move(trees_);
+    lampPositions = std::move(lamps_);
+    dirty = true;
+}
+
+bool StaticPlacement::update(const LodTerrain& terrain) {
+    std::uint64_t version = terrain.heightsVersion();
+    rebuilt = dirty;
+    if (dirty) {
+        treeXforms.resize(treePositions.size());
+        lampXforms.resize(lampPositions.size());
+        bulbXforms.resize(2 * lampPositions.size());
+        bulbWorld.resize(2 * lampPositions.size());
+        spotLights.resize(2 * lampPositions.size());
+        changedTrees.resize(treePositions.size());
+        changedLamps.resize(lampPositions.size());
+        std::iota(changedTrees.begin(), changedTrees.end(), 0u);
+        std::iota(changedLamps.begin(), changedLamps.end(), 0u);
+        placeTrees(terrain, changedTrees);
+        placeLamps(terrain, changedLamps);
+        treeSet.assign(treeXforms);
+        lampSet.assign(lampXforms);
+        bulbSet.assign(bulbXforms);
+        dirty = false;
+        terrainVersion = version;
+        return true;
+    }
+    if (version == terrainVersion)
+        return false;
+
+    changedOn(terrain, treePositions, changedTrees);
+    changedOn(terrain, lampPositions, changedLamps);
+    terrainVersion = version;
+    if (changedTrees.empty() && changedLamps.empty())
+        return false;
+    placeTrees(terrain, changedTrees);
+    placeLamps(terrain, changedLamps);
+    treeSet.update(treeXforms, changedTrees);
+    lampSet.update(lampXforms, changedLamps);
+    bulbSet.update(bulbXforms, changedBulbs);
+    return true;
+}
+
+void StaticPlacement::changedOn(const LodTerrain& terrain, const std::vector<glm::vec2>& positions,
+                                std::vector<std::uint32_t>& out) const {
+    out.clear();
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        if (terrain.heightsChangedIn(positions[i], positions[i], terrainVersion))
+            out.push_back(std::uint32_t(i));
+}
+
+void StaticPlacement::placeTrees(const LodTerrain& terrain, const std::vector<std::uint32_t>& which) {
+    queryXZ.clear();
+    for (std::uint32_t i : which) queryXZ.push_back(treePositions[i]);
+    heights.resize(queryXZ.size());
+    terrain.getHeightsAt(queryXZ.data(), queryXZ.size(), heights.data());
+    for (std::size_t k = 0; k < which.size(); ++k) {
+        const glm::vec2& p = queryXZ[k];
+        glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(p.x, heights[k] - treeBaseOffset, p.y));
+        treeXforms[which[k]] = glm::scale(M, glm::vec3(kTreeScale));
+    }
+}
+
+void StaticPlacement::placeLamps(const LodTerrain& terrain, const std::vector<std::uint32_t>& which) {
+    queryXZ.clear();
+    for (std::uint32_t i : which) queryXZ.push_back(lampPositions[i]);
+    heights.resize(queryXZ.size());
+    terrain.getHeightsAt(queryXZ.data(), queryXZ.size(), heights.data());
+    changedBulbs.clear();
+    for (std::size_t k = 0; k < which.size(); ++k) {
+        const glm::vec2& p = queryXZ[k];
+        // the lamp model's origin is its base
+        glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(p.x, heights[k], p.y));
+        M = glm::scale(M, glm::vec3(kLampScale));
+        lampXforms[which[k]] = M;
+
+        for (int b = 0; b < 2; ++b) {
+            std::uint32_t bulb = 2 * which[k] + std::uint32_t(b);
+            glm::vec3 pos = glm::vec3(M * bulbLocal[b]);
+            bulbWorld[bulb] = pos;
+            bulbXforms[bulb] = glm::scale(glm::translate(glm::mat4(1.0f), pos), glm::vec3(kBulbScale));
+            changedBulbs.push_back(bulb);
+
+            // each bulb points down and away from the post
+            SpotLight light(glm::vec3(1.0f, 0.85f, 0.6f), 45.0f, 60.5f);
+            light.Position  = pos;
+            light.Direction = glm::normalize(glm::vec3(0.0f, -1.0f, b == 0 ? 1.0f : -1.0f));
+            light.Constant  = 1.0f;
+            light.Linear    = 0.02f;
+            light.Quadratic = 0.005f;
+            spotLights[bulb] = light;
+        }
+    }
+}
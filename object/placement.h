@@ -0,0 +1,70 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "spotLight.hpp"
+#include "../ultis/instanceSet.h"
+#include "../terrain/lodterrain.h"
+
+// Trees and lamps standing on the terrain. They never move, so everything
+// derived from their positions (instance transforms, bulb positions, the
+// lamps' spotlights) is built once and kept until the positions change or the
+// terrain under them does. A tile streaming in or out only moves the objects
+// standing on it (LodTerrain::heightsChangedIn); a frame without either costs
+// nothing per object.
+class StaticPlacement {
+public:
+    // model-space bounds of the three meshes: trees are moved down onto the
+    // ground by their lowest y, the bulbs hang just below the lamp's top
+    StaticPlacement(const BoundingBox& tree, const BoundingBox& lamp, const BoundingBox& bulb);
+
+    StaticPlacement(const StaticPlacement&) = delete;
+    StaticPlacement& operator=(const StaticPlacement&) = delete;
+
+    // new (x, z) positions; the next update rebuilds everything
+    void place(std::vector<glm::vec2> trees, std::vector<glm::vec2> lamps);
+    // rebuilds everything if the positions changed, else just the objects
+    // whose terrain changed since the last call. true if anything moved
+    bool update(const LodTerrain& terrain);
+    // true if the last update rebuilt for new positions rather than for
+    // terrain changes, i.e. objects may have moved anywhere
+    bool repositioned() const { return rebuilt; }
+
+    // transforms and bounds; each pass culls them into its own VisibleInstances
+    const InstanceSet& trees() const { return treeSet; }
+    const InstanceSet& lamps() const { return lampSet; }
+    const InstanceSet& bulbs() const { return bulbSet; }
+
+    const std::vector<glm::vec3>& bulbPositions() const { return bulbWorld; }
+    // two per lamp, one per bulb
+    const std::vector<SpotLight>& lights() const { return spotLights; }
+
+private:
+    // transforms (and for lamps, bulbs and spotlights) of the listed objects
+    void placeTrees(const LodTerrain& terrain, const std::vector<std::uint32_t>& which);
+    void placeLamps(const LodTerrain& terrain, const std::vector<std::uint32_t>& which);
+    // indices of the objects in `positions` standing on terrain changed since terrainVersion
+    void changedOn(const LodTerrain& terrain, const std::vector<glm::vec2>& positions,
+                   std::vector<std::uint32_t>& out) const;
+
+    float     treeBaseOffset;
+    glm::vec4 bulbLocal[2];   // lamp-model space
+
+    std::vector<glm::vec2> treePositions, lampPositions;
+    std::vector<glm::vec2> queryXZ;   // scratch for the terrain query
+    std::vector<float>     heights;
+    std::vector<std::uint32_t> changedTrees, changedLamps, changedBulbs;
+
+    std::vector<glm::mat4> treeXforms, lampXforms, bulbXforms;   // every object, as in the sets
+    std::vector<glm::vec3> bulbWorld;
+    std::vector<SpotLight> spotLights;
+    InstanceSet            treeSet, lampSet, bulbSet;
+
+    bool          dirty = false;
+    bool          rebuilt = false;
+    std::uint64_t terrainVersion = 0;   // heightsVersion the cache was built on
+};
+
+#endif // PLACEMENT_H
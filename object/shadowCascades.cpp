@@ -0,0 +1,281 @@
+#include "shadowCascades.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// 0: even splits, 1: logarithmic; in between keeps the first cascade from
+// collapsing onto the near plane
+static const float kSplitLambda = 0.75f;
+// depth bias, in texels of the cascade
+static const float kBiasTexels  = 1.5f;
+// layers are rendered for a sphere this much larger than the slice, so the
+// camera can move a little before the layer has to be redrawn
+static const float kSlack = 1.15f;
+// the sun's elevation used for the caster reach is never taken below this;
+// a grazing sun would otherwise pull in casters from across the map
+static const float kMinSunHeight = 0.05f;
+
+ShadowCascades::ShadowCascades(int resolution_, float casterHeight_)
+    : size(resolution_), casterHeight(casterHeight_)
+    , esmShader("shaders/shadow_esm.vs", "shaders/shadow_esm.fs")
+{
+    for (int c = 0; c < kShadowCascades; ++c) {
+        matrices[c] = glm::mat4(1.0f);
+        splits[c] = 0.0f;
+        bias[c] = 0.0f;
+    }
+
+    glGenTextures(1, &depthArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, kShadowCascades,
+                 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    // sampled as sampler2DArrayShadow: LINEAR blends four depth compares
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+    // ESM: half resolution, full mip chain
+    int esmSize = esmResolution(), levels = 1;
+    while ((esmSize >> levels) > 0) ++levels;
+    glGenTextures(1, &esmArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, esmArray);
+    for (int level = 0; level < levels; ++level)
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_R32F, std::max(esmSize >> level, 1),
+                     std::max(esmSize >> level, 1), kShadowCascades, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenSamplers(1, &rawDepthSampler);
+    glSamplerParameteri(rawDepthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glSamplerParameteri(rawDepthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(rawDepthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenVertexArrays(1, &emptyVAO);
+    esmShader.use();
+    esmShader.setInt("depthLayers", 0);
+
+    glGenFramebuffers(kShadowCascades, fbos);
+    for (int c = 0; c < kShadowCascades; ++c) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[c]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, c);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::SHADOW_MAP:: Cascade " << c << " framebuffer not complete!" << std::endl;
+    }
+    glGenFramebuffers(kShadowCascades, esmFbos);
+    for (int c = 0; c < kShadowCascades; ++c) {
+        glBindFramebuffer(GL_FRAMEBUFFER, esmFbos[c]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, esmArray, 0, c);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::SHADOW_MAP:: ESM " << c << " framebuffer not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowCascades::~ShadowCascades() {
+    glDeleteFramebuffers(kShadowCascades, fbos);
+    glDeleteFramebuffers(kShadowCascades, esmFbos);
+    glDeleteTextures(1, &depthArray);
+    glDeleteTextures(1, &esmArray);
+    glDeleteSamplers(1, &rawDepthSampler);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void ShadowCascades::setFilter(Filter filter) {
+    if (filter == mode) return;
+    mode = filter;
+    invalidate();
+}
+
+void ShadowCascades::invalidate() {
+    for (Layer& l : layers) l.valid = false;
+}
+
+void ShadowCascades::bind() const {
+    glActiveTexture(GL_TEXTURE0 + kDepthUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+    glActiveTexture(GL_TEXTURE0 + kEsmUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, esmArray);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowCascades::setSamplers(const Shader& shader) {
+    shader.setInt("shadowMap", kDepthUnit);
+    shader.setInt("shadowEsm", kEsmUnit);
+}
+
+void ShadowCascades::resolveEsm(int c) {
+    glDisable(GL_DEPTH_TEST);
+    esmShader.use();
+    esmShader.setInt("layer", c);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+    glBindSampler(0, rawDepthSampler);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindSampler(0, 0);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, esmArray);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void ShadowCascades::update(const glm::mat4& view, float fovY, float aspect, float zNear,
+                            float shadowDistance, const glm::vec3& sunDir, bool sunUp,
+                            const LodTerrain& terrain) {
+    for (bool& p : pending) p = false;
+    if (!sunUp) {
+        // by sunrise every layer is stale; start the day with all of them
+        for (Layer& l : layers) l.valid = false;
+        return;
+    }
+
+    glm::mat4 invView = glm::inverse(view);
+    float tanY = std::tan(0.5f * fovY), tanX = tanY * aspect;
+    glm::vec3 centers[kShadowCascades];
+    float     radii[kShadowCascades];
+    float start = zNear;
+    for (int c = 0; c < kShadowCascades; ++c) {
+        float f = float(c + 1) / kShadowCascades;
+        float logSplit = zNear * std::pow(shadowDistance / zNear, f);
+        float linSplit = zNear + (shadowDistance - zNear) * f;
+        splits[c] = kSplitLambda * logSplit + (1.0f - kSplitLambda) * linSplit;
+
+        // sphere around the slice: its size doesn't change as the camera turns
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        int k = 0;
+        for (float d : {start, splits[c]})
+            for (float sy : {-1.0f, 1.0f})
+                for (float sx : {-1.0f, 1.0f}) {
+                    corners[k] = glm::vec3(invView * glm::vec4(sx * tanX * d, sy * tanY * d, -d, 1.0f));
+                    center += corners[k++];
+                }
+        center /= 8.0f;
+        float radius = 0.0f;
+        for (const glm::vec3& p : corners) radius = std::max(radius, glm::length(p - center));
+        centers[c] = center;
+        radii[c] = radius;
+        start = splits[c];
+    }
+
+    // empty layers first, then stale ones round-robin within the budget
+    std::uint64_t version = terrain.heightsVersion();
+    int budget = refreshesPerFrame;
+    for (int i = 0; i < kShadowCascades; ++i) {
+        int c = (nextRefresh + i) % kShadowCascades;
+        if (!stale(layers[c], centers[c], radii[c], sunDir, terrain)) {
+            // nothing under it changed so far; keeps its version inside the
+            // terrain's change history
+            layers[c].terrainVersion = version;
+            continue;
+        }
+        if (layers[c].valid) {
+            if (budget <= 0) continue;
+            --budget;
+            nextRefresh = (c + 1) % kShadowCascades;
+        }
+        fit(c, centers[c], radii[c] * kSlack, sunDir, terrain);
+        layers[c].valid = true;
+        layers[c].center = centers[c];
+        layers[c].radius = radii[c] * kSlack;
+        layers[c].sun = sunDir;
+        layers[c].terrainVersion = version;
+        pending[c] = true;
+    }
+}
+
+int ShadowCascades::renderCount() const {
+    int n = 0;
+    for (bool p : pending) n += p ? 1 : 0;
+    return n;
+}
+
+bool ShadowCascades::stale(const Layer& layer, const glm::vec3& center, float radius,
+                           const glm::vec3& sunDir, const LodTerrain& terrain) const {
+    if (!layer.valid) return true;
+    // tiles streaming elsewhere leave the layer alone
+    if (terrain.heightsChangedIn(layer.terrainLo, layer.terrainHi, layer.terrainVersion)) return true;
+    if (glm::dot(layer.sun, sunDir) < std::cos(sunThreshold)) return true;
+    // the slice has to stay inside what was rendered, less a texel for the snapping
+    float texel = 2.0f * layer.radius / float(size);
+    return glm::length(center - layer.center) + radius > layer.radius - texel;
+}
+
+void ShadowCascades::fit(int c, const glm::vec3& center, float radius, const glm::vec3& sunDir,
+                         const LodTerrain& terrain) {
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    // light space: depends only on the sun, so the texel grid below stays put
+    glm::vec3 up = std::fabs(sunDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightRot = glm::lookAt(glm::vec3(0.0f), -sunDir, up);
+    float texel = 2.0f * radius / float(size);
+    glm::vec3 centerLS = glm::vec3(lightRot * glm::vec4(center, 1.0f));
+    centerLS.x = std::floor(centerLS.x / texel) * texel;
+    centerLS.y = std::floor(centerLS.y / texel) * texel;
+
+    // receivers: the terrain under the sphere and what stands on it
+    glm::vec2 lo(center.x - radius, center.z - radius), hi(center.x + radius, center.z + radius);
+    float minH, maxH;
+    if (terrain.heightBoundsIn(lo, hi, minH, maxH)) {
+        maxH += casterHeight;
+    } else {
+        minH = center.y - radius;
+        maxH = center.y + radius;
+    }
+    float bottom = std::max(minH, center.y - radius);
+    float top    = std::max(std::min(maxH, center.y + radius), bottom);
+
+    // casters: anything up to the highest terrain (plus objects) between the
+    // receivers and the sun; the footprint grows towards the sun with height
+    glm::vec2 run = glm::vec2(sunDir.x, sunDir.z) / std::max(sunDir.y, kMinSunHeight);
+    glm::vec2 casterLo = lo, casterHi = hi;
+    float casterTop = top;
+    for (int step = 0; step < 2; ++step) {
+        glm::vec2 shift = run * (casterTop - bottom);
+        casterLo = glm::min(lo, lo + shift);
+        casterHi = glm::max(hi, hi + shift);
+        float cMin, cMax;
+        if (terrain.heightBoundsIn(casterLo, casterHi, cMin, cMax))
+            casterTop = std::max(casterTop, cMax + casterHeight);
+    }
+
+    float zMin = 1e30f, zMax = -1e30f;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 p((i & 1) ? casterHi.x : casterLo.x, (i & 2) ? casterTop : bottom,
+                    (i & 4) ? casterHi.y : casterLo.y);
+        float z = (lightRot * glm::vec4(p, 1.0f)).z;
+        zMin = std::min(zMin, z);
+        zMax = std::max(zMax, z);
+    }
+    zMin -= 1.0f;
+    zMax += 1.0f;
+
+    glm::mat4 proj = glm::ortho(centerLS.x - radius, centerLS.x + radius,
+                                centerLS.y - radius, centerLS.y + radius,
+                                -zMax, -zMin);
+    matrices[c] = proj * lightRot;
+    layers[c].terrainLo = casterLo;
+    layers[c].terrainHi = casterHi;
+    bias[c] = kBiasTexels * texel / (zMax - zMin);
+}
+
+void ShadowCascades::fill(FrameBlock& frame) const {
+    for (int c = 0; c < kShadowCascades; ++c) {
+        frame.cascadeMatrices[c] = matrices[c];
+        frame.cascadeBias[c] = bias[c];
+    }
+    frame.shadowFilter = int(mode);
+}
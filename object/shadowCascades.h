@@ -0,0 +1,135 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include "../lib/glad.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include "../ultis/frameUniforms.h"
+#include "../ultis/shaderReader.h"
+#include "../terrain/lodterrain.h"
+
+// Cascaded shadow maps for the sun.
+//
+// The camera frustum, up to the shadow distance, is cut into kShadowCascades
+// depth slices (a mix of logarithmic and even splits). Each slice gets its
+// own orthographic light matrix and one layer of a depth texture array:
+//   - x/y cover the sphere around the slice, snapped to whole texels so the
+//     shadows don't crawl as the camera turns or moves
+//   - z spans only what can receive or cast a shadow in it: the terrain's
+//     min/max height under the slice (LodTerrain::heightBoundsIn) plus the
+//     tallest object, extended towards the sun over the casters' terrain
+// The shaders (terrain.fs, lit.fs) use the finest cascade that contains the
+// fragment, filtered one of two ways (Filter):
+//   Pcf  depth compare in the sampler (sampler2DArrayShadow, GL_LINEAR), so
+//        each tap is a bilinear 2x2 PCF; four taps per fragment
+//   Esm  exponential shadow maps: every redrawn layer is resolved into a
+//        half-resolution exp(kEsmExponent * depth) array with mipmaps, which
+//        filters like colour; one trilinear tap gives a soft shadow
+//
+// Everything that casts a shadow here (terrain, trees, lamps) is static, so a
+// rendered layer stays valid until the sun turns more than sunThreshold, the
+// terrain changes under its receivers or casters, or the camera slice leaves the region it was rendered for
+// (layers are rendered with some slack around the slice). Stale layers are
+// re-rendered round-robin, a few per frame, and keep serving the region they
+// cover until then; none are rendered while the sun is down.
+class ShadowCascades {
+public:
+    enum class Filter : int { Pcf = 0, Esm = 1 };   // Frame block shadowFilter
+
+    // texture units the depth array and the ESM array live on
+    static const int kDepthUnit = 5;
+    static const int kEsmUnit   = 9;
+    // ESM_C in the shaders; exp(80) still fits a float
+    static constexpr float kEsmExponent = 80.0f;
+
+    // resolution: of each layer; casterHeight: tallest object standing on the terrain
+    ShadowCascades(int resolution, float casterHeight);
+    ~ShadowCascades();
+
+    ShadowCascades(const ShadowCascades&) = delete;
+    ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+    // fit the cascades to the camera (view, fovY, aspect, zNear) up to
+    // shadowDistance and pick the layers to re-render this frame; sunDir
+    // points from the scene towards the sun
+    void update(const glm::mat4& view, float fovY, float aspect, float zNear, float shadowDistance,
+                const glm::vec3& sunDir, bool sunUp, const LodTerrain& terrain);
+
+    // cascade matrices, depth bias and filter for the Frame block
+    void fill(FrameBlock& frame) const;
+
+    // switching redraws every layer
+    void setFilter(Filter filter);
+    // redraw every layer, e.g. after the objects casting into them moved
+    void invalidate();
+    Filter filter() const { return mode; }
+
+    // bind both arrays to their texture units
+    void bind() const;
+    // point a program's samplers at the units above
+    static void setSamplers(const Shader& shader);
+
+    // ESM: fill the bound framebuffer (esmFramebuffer(cascade)) from the
+    // layer's depth and rebuild the mipmaps
+    void resolveEsm(int cascade);
+
+    // whether the layer has to be drawn this frame (with matrix(cascade))
+    bool needsRender(int cascade) const { return pending[cascade]; }
+    int  renderCount() const;
+
+    // the light matrix the layer is (or is about to be) rendered with
+    const glm::mat4& matrix(int cascade) const { return matrices[cascade]; }
+    // view distance where each cascade ends
+    float splitDistance(int cascade) const { return splits[cascade]; }
+
+    GLuint texture() const { return depthArray; }
+    // depth-only framebuffer drawing into one layer
+    GLuint framebuffer(int cascade) const { return fbos[cascade]; }
+    int resolution() const { return size; }
+    GLuint esmFramebuffer(int cascade) const { return esmFbos[cascade]; }
+    int esmResolution() const { return size / 2; }
+
+    // re-render when the sun has turned further than this since (radians)
+    float sunThreshold = 0.01f;
+    // stale layers re-rendered per frame; layers with nothing in them yet
+    // are always rendered
+    int   refreshesPerFrame = 1;
+
+private:
+    struct Layer {
+        bool          valid = false;
+        glm::vec3     center = glm::vec3(0.0f);   // sphere the layer was rendered for
+        float         radius = 0.0f;
+        glm::vec3     sun = glm::vec3(0.0f);
+        glm::vec2     terrainLo = glm::vec2(0.0f), terrainHi = glm::vec2(0.0f);   // xz it was fitted to
+        std::uint64_t terrainVersion = 0;
+    };
+
+    bool stale(const Layer& layer, const glm::vec3& center, float radius,
+               const glm::vec3& sunDir, const LodTerrain& terrain) const;
+    void fit(int cascade, const glm::vec3& center, float radius, const glm::vec3& sunDir,
+             const LodTerrain& terrain);
+
+    int   size;
+    float casterHeight;
+
+    glm::mat4 matrices[kShadowCascades];
+    float     splits[kShadowCascades];
+    float     bias[kShadowCascades];      // in each cascade's depth units
+    Layer     layers[kShadowCascades];
+    bool      pending[kShadowCascades] = {};
+    int       nextRefresh = 0;            // round-robin cursor
+
+    Filter mode = Filter::Pcf;
+
+    GLuint depthArray = 0;
+    GLuint fbos[kShadowCascades] = {};
+
+    GLuint esmArray = 0;
+    GLuint esmFbos[kShadowCascades] = {};
+    GLuint rawDepthSampler = 0;   // depth without the compare, for the resolve
+    GLuint emptyVAO = 0;          // the resolve's triangle comes from gl_VertexID
+    Shader esmShader;
+};
+
+#endif // SHADOW_CASCADES_H
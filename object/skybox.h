@@ -4,11 +4,11 @@
 #include "../lib/glad.h"
 #include <vector>
 #include <string>
-#include "../lib/stb_image.h"
+#include "../ultis/assetLoader.h"
 class Skybox {
 private:
     unsigned int skyboxVAO, skyboxVBO;
-    unsigned int cubemapTexture;
+    TextureHandle cubemapTexture;
 
     float skyboxVertices[108] = {
         // positions          
@@ -55,12 +55,11 @@ private:
          1.0f, -1.0f,  1.0f
     };
 
-    unsigned int loadCubemap(const std::vector<std::string>& faces);
-
 public:
-    Skybox(const std::vector<std::string>& faces);
+    // faces: +x, -x, +y, -y, +z, -z, decoded in parallel by assets
+    Skybox(AssetLoader& assets, const std::vector<std::string>& faces);
     ~Skybox();
     void render();
-    unsigned int getTextureID() const { return cubemapTexture; }
+    unsigned int getTextureID() const { return cubemapTexture.id(); }
 };
 #endif
\ No newline at end of file
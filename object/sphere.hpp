@@ -1,11 +1,16 @@
 #pragma once
 #include <vector>
 #include "../lib/glad.h"
+#include "../ultis/instanceBuffer.h"
+#include "../ultis/renderQueue.h"
+#include "../ultis/frustum.h"
 
 struct Sphere {
     // OpenGL handles
     GLuint VAO = 0, VBO = 0, EBO = 0;
     GLsizei indexCount = 0;
+    // unit radius around the origin
+    BoundingBox bounds{glm::vec3(-1.0f), glm::vec3(1.0f)};
 
     // Call once after GL context is ready:
     void build(unsigned int sectorCount = 32, unsigned int stackCount = 16);
@@ -16,4 +21,30 @@ struct Sphere {
         glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
         glBindVertexArray(0);
     }
+
+    // one draw for every transform in `instances` (shader reads aInstanceModel)
+    void drawInstanced(const InstanceBuffer& instances) {
+        if (instances.count() == 0) return;
+        glBindVertexArray(VAO);
+        if (instanceVBO != instances.id()) {
+            instances.attach();
+            instanceVBO = instances.id();
+        }
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, instances.count());
+        glBindVertexArray(0);
+    }
+
+    // drawInstanced through a render queue; untextured
+    void submitInstanced(RenderQueue& queue, Shader& shader, const InstanceBuffer& instances) {
+        DrawItem item;
+        item.shader     = &shader;
+        item.vao        = VAO;
+        item.indexCount = indexCount;
+        item.instances  = &instances;
+        item.attached   = &instanceVBO;
+        item.key = RenderQueue::makeKey(shader.ID, 0, VAO);
+        queue.push(item);
+    }
+
+    GLuint instanceVBO = 0;   // instance buffer the VAO currently points at
 };
\ No newline at end of file
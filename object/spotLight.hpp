@@ -33,19 +33,4 @@ struct SpotLight {
       , Diffuse(color)
       , Specular(color)
     {}
-
-    /// Upload this spotlight’s uniforms into `shader` under array name e.g. "spotLights[3]"
-    void ApplyToShader(const Shader &shader, const std::string &uniformBase) const {
-        shader.setBool  (uniformBase + ".Enabled",     Enabled);
-        shader.setVec3  (uniformBase + ".Position",    Position);
-        shader.setVec3  (uniformBase + ".Direction",   Direction);
-        shader.setFloat (uniformBase + ".CutOff",      CutOff);
-        shader.setFloat (uniformBase + ".OuterCutOff", OuterCutOff);
-        shader.setFloat (uniformBase + ".Constant",    Constant);
-        shader.setFloat (uniformBase + ".Linear",      Linear);
-        shader.setFloat (uniformBase + ".Quadratic",   Quadratic);
-        shader.setVec3  (uniformBase + ".Ambient",     Ambient);
-        shader.setVec3  (uniformBase + ".Diffuse",     Diffuse);
-        shader.setVec3  (uniformBase + ".Specular",    Specular);
-    }
 };
@@ -1,9 +1,10 @@
  #include "water.h"
-#include "../lib/stb_image.h"
+#include "../ultis/frameUniforms.h"
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
-Water::Water(const char* dudvPath,
+Water::Water(AssetLoader& assets,
+             const char* dudvPath,
              const char* normalPath,
              int         width,
              int         height,
@@ -22,8 +23,8 @@ Water::Water(const char* dudvPath,
     InitializeFrameBuffer(refractionFBO, refractionTexture, refractionDepthTexture, false);
 
     // 3) Load DuDv map và Normal map
-    LoadTexture(dudvPath,    dudvTexture);
-    LoadTexture(normalPath,  normalMapTexture);
+    dudvTexture      = assets.texture(dudvPath);
+    normalMapTexture = assets.texture(normalPath);
 
     // 4) Tạo quad (mặt phẳng) ở y = 0 (model matrix sẽ translate lên y = waterHeight)
     CreateWaterQuad();
@@ -36,6 +37,7 @@ Water::Water(const char* dudvPath,
     waterShader.setInt("texNormal",      3);
     waterShader.setInt("texDepthRefract",1); // refractionDepthTexture dùng chung slot với texRefract (đọc r-channel)
     waterShader.setInt("texSkybox",      4);
+    bindFrameBlocks(waterShader);
 }
 
 Water::~Water() {
@@ -46,8 +48,6 @@ Water::~Water() {
     glDeleteTextures(1,     &refractionTexture);
     glDeleteRenderbuffers(1,&reflectionDepthBuffer);
     glDeleteTextures(1,     &refractionDepthTexture);
-    glDeleteTextures(1,     &dudvTexture);
-    glDeleteTextures(1,     &normalMapTexture);
     glDeleteVertexArrays(1, &waterVAO);
     glDeleteBuffers(1,      &waterVBO);
 }
@@ -98,29 +98,6 @@ void Water::InitializeFrameBuffer(GLuint& fbo,
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void Water::LoadTexture(const char* path, GLuint& textureID) {
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    int w, h, n;
-    unsigned char* data = stbi_load(path, &w, &h, &n, 0);
-    if (!data) {
-        std::cerr << "Failed to load texture: " << path << std::endl;
-        return;
-    }
-    GLenum format = (n == 4 ? GL_RGBA : GL_RGB);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Set wrap & filter
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-}
-
 void Water::CreateWaterQuad() {
     // Một quad nằm trên y=0, toạ độ x/z ∈ [-quadSize, +quadSize], UV ∈ [0,1]
     float s = quadSize;
@@ -169,24 +146,14 @@ void Water::UnbindFrameBuffer(int screenWidth, int screenHeight) {
 }
 
 void Water::Draw(const glm::mat4& M,
-                 const glm::mat4& V,
-                 const glm::mat4& P,
-                 const glm::vec3& eyePoint,
-                 const glm::vec3& lightPos,
-                 const glm::vec3& lightColor,
                  float            dudvMove,
                  GLuint           skyboxCubemap)
 {
     // 1) Sử dụng shader
     waterShader.use();
 
-    // 2) Truyền các uniform matrix + ánh sáng + camera
+    // 2) Model matrix + DuDv; camera và ánh sáng đến từ block Camera/Frame
     waterShader.setMat4("M", M);
-    waterShader.setMat4("V", V);
-    waterShader.setMat4("P", P);
-    waterShader.setVec3("eyePoint",     eyePoint);
-    waterShader.setVec3("lightPos",     lightPos);
-    waterShader.setVec3("lightColor",   lightColor);
     waterShader.setFloat("dudvMove",    dudvMove);
 
     // 3) Nếu có skyboxCubemap, bind nó vào slot 4
@@ -206,11 +173,11 @@ void Water::Draw(const glm::mat4& M,
 
     //   texDudv     → GL_TEXTURE2
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, dudvTexture);
+    glBindTexture(GL_TEXTURE_2D, dudvTexture.id());
 
     //   texNormal   → GL_TEXTURE3
     glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, normalMapTexture);
+    glBindTexture(GL_TEXTURE_2D, normalMapTexture.id());
 
     //   texDepthRefract (đọc r-channel từ refractionDepthTexture) → GL_TEXTURE1 (chồng chung với texRefract)
     //   Trong shader bạn đã dùng texture(texDepthRefract, ndc).r; nên chỉ cần active lại GL_TEXTURE1 
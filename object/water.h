@@ -4,6 +4,8 @@
 #include "../lib/glad.h"
 #include <glm/glm.hpp>
 #include "../ultis/shaderReader.h"
+#include "../ultis/frustum.h"
+#include "../ultis/assetLoader.h"
 
 /**
  * Class Water:
@@ -16,6 +18,7 @@
 class Water {
 public:
     /**
+     * @param assets     Nạp DuDv / Normal map ở luồng nền; texture có sau lần upload kế tiếp.
      * @param dudvPath   Đường dẫn tới DuDv map (thường là PNG hoặc JPG).
      * @param normalPath Đường dẫn tới Normal map tương ứng.
      * @param width      Chiều rộng của texture reflection / refraction (FBO size).
@@ -23,7 +26,8 @@ public:
      * @param waterH     Hàm lượng cao y (height) của mặt nước trong world space.
      * @param quadSize   Bán kính của quad (tức quad rộng 2*quadSize).
      */
-    Water(const char* dudvPath,
+    Water(AssetLoader& assets,
+          const char* dudvPath,
           const char* normalPath,
           int         width,
           int         height,
@@ -43,22 +47,14 @@ public:
 
     /**
      * Vẽ mặt nước (đã có sẵn reflectionTexture, refractionTexture, refractionDepthTexture).
+     * View/projection, vị trí camera và ánh sáng lấy từ uniform block Camera/Frame
+     * (ultis/frameUniforms.h), phải được cập nhật trước khi gọi.
      * @param M           Model matrix cho quad (thường là translate(0, waterH, 0)).
-     * @param V           View matrix (camera thật).
-     * @param P           Projection matrix.
-     * @param eyePoint    Vị trí camera (world space).
-     * @param lightPos    Vị trí đèn (world space).
-     * @param lightColor  Màu đèn (RGB).
      * @param dudvMove    Giá trị dịch chuyển DuDv (0→1) để duy trì ripples theo thời gian.
      * @param skyboxCubemap (Không bắt buộc) Texture cube map của skybox (nếu muốn hàm environment).  
      *                      Trong shader hiện tại bạn có uniform samplerCube nhưng chưa dùng, nên truyền vào nếu cần.
      */
     void Draw(const glm::mat4& M,
-              const glm::mat4& V,
-              const glm::mat4& P,
-              const glm::vec3& eyePoint,
-              const glm::vec3& lightPos,
-              const glm::vec3& lightColor,
               float            dudvMove,
               GLuint           skyboxCubemap = 0);
 
@@ -68,6 +64,16 @@ public:
     GLuint getRefractionTexture()   const { return refractionTexture; }
     /// Lấy ra depth texture của refraction (dùng trong water.fs để tint nước theo depth).
     GLuint getDepthTexture()        const { return refractionDepthTexture; }
+    /// FBO reflection / refraction và kích thước của chúng (cho render graph).
+    GLuint getReflectionFBO()       const { return reflectionFBO; }
+    GLuint getRefractionFBO()       const { return refractionFBO; }
+    int    getTextureWidth()        const { return reflectionWidth; }
+    int    getTextureHeight()       const { return reflectionHeight; }
+    /// AABB của quad nước trong world space (để cull).
+    BoundingBox getBounds() const {
+        return BoundingBox{glm::vec3(-quadSize, waterHeight, -quadSize),
+                           glm::vec3( quadSize, waterHeight,  quadSize)};
+    }
 
 private:
     /// Khởi tạo 1 FBO:
@@ -78,9 +84,6 @@ private:
                                GLuint& depthAttachment,
                                bool    isReflection);
 
-    /// Load 1 texture 2D (DuDv or Normal). Kết quả lưu vào textureID.
-    void LoadTexture(const char* path, GLuint& textureID);
-
     /// Tạo quad (6 vertices) với layout [pos.xyz | uv.xy].
     void CreateWaterQuad();
 
@@ -93,9 +96,9 @@ private:
     GLuint refractionTexture;
     GLuint refractionDepthTexture;   // depth texture nếu !isReflection
 
-    // DuDv + Normal
-    GLuint dudvTexture;
-    GLuint normalMapTexture;
+    // DuDv + Normal (dùng chung qua AssetLoader)
+    TextureHandle dudvTexture;
+    TextureHandle normalMapTexture;
 
     // Quad VAO/VBO
     GLuint waterVAO;
@@ -12,21 +12,41 @@ out vec4 FragColor;
 
 // ---- samplers ----
 uniform sampler2D diffuseMap;
-uniform sampler2D shadowMap;         // unit 5
-uniform mat4      lightSpaceMatrix;
+uniform sampler2DArrayShadow shadowMap;   // unit 5, one layer per cascade, hardware compare
+uniform sampler2DArray       shadowEsm;   // unit 9, exp(ESM_C * depth) with mipmaps
 
-// ---- sun / directional light ----
-uniform vec3 viewPos;
-uniform vec3 lightPos;               // sun position (for specular)
-uniform vec3 lightColor;             // sun color
+// ---- camera, sun (lightPos / lightColor) and fog ----
+// per-pass camera, shared by terrain/lit/water (ultis/frameUniforms.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec2 clusterDepth;   // light cluster slice = log(depth)*x - y
+};
+#define SHADOW_CASCADES 4   // kShadowCascades
+// per-frame sun, water tint and fog (ultis/frameUniforms.h)
+layout(std140) uniform Frame {
+    mat4  cascadeMatrices[SHADOW_CASCADES];   // world -> light clip space
+    vec4  cascadeBias;                        // depth bias per cascade
+    vec3  lightPos;      float dayFactor;
+    vec3  lightDir;      float ambientStrength;   // normalized, from the sun down
+    vec3  lightColor;    bool  shadowsEnabled;
+    vec3  shallowColor;  float waterHeight;
+    vec3  deepColor;     float maxDepth;
+    vec3  fogColor;      float fogStart;
+    float fogEnd;        int   shadowFilter;      // 0: PCF, 1: ESM
+};
 
-// ---- fog ----
-uniform float fogStart;
-uniform float fogEnd;
-uniform vec3  fogColor;
+// ---- spotlights ----
+// clustered: lights packed in a buffer, each view-space froxel lists the ones
+// reaching it (object/lightClusters.h; the grid size must match kTiles/kSlices)
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+uniform samplerBuffer  spotLightData;   // 5 texels per light
+uniform usamplerBuffer clusterGrid;     // first index, count per froxel
+uniform usamplerBuffer clusterLights;   // light indices grouped by froxel
 
-// ---- spotlight support ----
-#define MAX_SPOTLIGHTS 10
 struct SpotLight {
     vec3 Position;
     vec3 Direction;
@@ -39,24 +59,61 @@ struct SpotLight {
     float Linear;
     float Quadratic;
 };
-uniform int        numSpotLights;
-uniform SpotLight  spotLights[MAX_SPOTLIGHTS];
-
-// ---- helper: shadow calculation (PCF) ----
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 N) {
-    vec3 proj = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    proj = proj * 0.5 + 0.5;
-    if(proj.z > 1.0) return 0.0;
-    float bias = max(0.05 * (1.0 - dot(N, normalize(lightPos - fs.FragPos))), 0.005);
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap,0);
-    for(int x=-1; x<=1; ++x){
-      for(int y=-1; y<=1; ++y){
-        float p = texture(shadowMap, proj.xy + vec2(x,y)*texelSize).r;
-        if(proj.z - bias > p) shadow += 1.0;
+
+SpotLight fetchSpotLight(int i) {
+    vec4 t0 = texelFetch(spotLightData, i*5);
+    vec4 t1 = texelFetch(spotLightData, i*5 + 1);
+    vec4 t2 = texelFetch(spotLightData, i*5 + 2);
+    vec4 t3 = texelFetch(spotLightData, i*5 + 3);
+    vec4 t4 = texelFetch(spotLightData, i*5 + 4);
+    SpotLight l;
+    l.Position  = t0.xyz;  l.Constant    = t0.w;
+    l.Direction = t1.xyz;  l.Linear      = t1.w;
+    l.Ambient   = t2.xyz;  l.Quadratic   = t2.w;
+    l.Diffuse   = t3.xyz;  l.CutOff      = t3.w;
+    l.Specular  = t4.xyz;  l.OuterCutOff = t4.w;
+    return l;
+}
+
+// (first index, count) into clusterLights for the froxel holding worldPos
+uvec2 clusterRange(vec3 worldPos) {
+    vec4  viewP = view * vec4(worldPos, 1.0);
+    vec4  clip  = projection * viewP;
+    vec2  uv    = clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 0.999);
+    int   slice = clamp(int(floor(log(max(-viewP.z, 1e-4)) * clusterDepth.x - clusterDepth.y)), 0, CLUSTER_Z - 1);
+    ivec2 tile  = ivec2(uv * vec2(CLUSTER_X, CLUSTER_Y));
+    return texelFetch(clusterGrid, (slice*CLUSTER_Y + tile.y)*CLUSTER_X + tile.x).xy;
+}
+
+// ---- helper: shadow calculation (finest cascade holding the fragment;
+// four hardware bilinear compares, or one trilinear ESM tap) ----
+#define ESM_C 80.0   // ShadowCascades::kEsmExponent
+float ShadowCalculation(vec3 fragPos, vec3 N) {
+    // derivatives here, in uniform control flow, for the ESM mip
+    vec3 dx = dFdx(fragPos), dy = dFdy(fragPos);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap,0).xy);
+    float slope = 1.0 - max(dot(N, normalize(lightPos - fragPos)), 0.0);
+    for(int c=0; c<SHADOW_CASCADES; ++c){
+      vec4 ls = cascadeMatrices[c] * vec4(fragPos, 1.0);
+      vec3 proj = ls.xyz / ls.w * 0.5 + 0.5;
+      if(proj.z > 1.0 || any(lessThan(proj.xy, texelSize)) || any(greaterThan(proj.xy, 1.0 - texelSize)))
+        continue;
+      if(shadowFilter == 1){
+        vec2 gx = 0.5 * (cascadeMatrices[c] * vec4(dx, 0.0)).xy;
+        vec2 gy = 0.5 * (cascadeMatrices[c] * vec4(dy, 0.0)).xy;
+        float occ = textureGrad(shadowEsm, vec3(proj.xy, float(c)), gx, gy).r;
+        return 1.0 - clamp(occ * exp(-ESM_C * proj.z), 0.0, 1.0);
+      }
+      float ref = proj.z - cascadeBias[c] * (1.0 + 2.0 * slope);
+      float lit = 0.0;
+      for(int x=0; x<2; ++x){
+        for(int y=0; y<2; ++y){
+          lit += texture(shadowMap, vec4(proj.xy + (vec2(x,y) - 0.5)*texelSize, float(c), ref));
+        }
       }
+      return 1.0 - lit * 0.25;
     }
-    return shadow/9.0;
+    return 0.0;
 }
 
 // ---- helper: calculate one spotlight’s contribution ----
@@ -102,14 +159,15 @@ void main() {
     vec3 specular = spec * lightColor * 0.3;
 
     // 3) shadow from sun
-    vec4 posLS = lightSpaceMatrix * vec4(fs.FragPos,1.0);
-    float shadow = ShadowCalculation(posLS, N);
+    float shadow = shadowsEnabled ? ShadowCalculation(fs.FragPos, N) : 0.0;
     vec3 sunContrib = ambient + (1.0 - shadow)*(diffuse + specular);
 
     // 4) accumulate all spotlights
     vec3 spotContrib = vec3(0.0);
-    for(int i=0; i<numSpotLights; ++i){
-        spotContrib += CalcSpotLight(spotLights[i], N, fs.FragPos, V, albedo);
+    uvec2 cl = clusterRange(fs.FragPos);
+    for(uint k=0u; k<cl.y; ++k){
+        int li = int(texelFetch(clusterLights, int(cl.x + k)).r);
+        spotContrib += CalcSpotLight(fetchSpotLight(li), N, fs.FragPos, V, albedo);
     }
 
     // 5) fog
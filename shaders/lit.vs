@@ -2,6 +2,7 @@
 layout (location=0) in vec3 aPos;
 layout (location=1) in vec3 aNormal;
 layout (location=2) in vec2 aTexCoords;
+layout (location=7) in mat4 aInstanceModel;   // per instance (ultis/instanceBuffer.h)
   
 out VS_OUT {
     vec3 FragPos;
@@ -9,13 +10,19 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
   
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-pass camera, shared by terrain/lit/water (ultis/frameUniforms.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec2 clusterDepth;   // light cluster slice = log(depth)*x - y
+};
   
 void main() {
-    vs_out.FragPos   = vec3(model * vec4(aPos,1.0));
-    vs_out.Normal    = mat3(transpose(inverse(model))) * aNormal;
+    vs_out.FragPos   = vec3(aInstanceModel * vec4(aPos,1.0));
+    // instances are translate + uniform scale, so the upper 3x3 is the normal
+    // matrix up to scale (lit.fs normalizes); no per-vertex inverse
+    vs_out.Normal    = mat3(aInstanceModel) * aNormal;
     vs_out.TexCoords = aTexCoords;
     gl_Position      = projection * view * vec4(vs_out.FragPos, 1.0);
 }
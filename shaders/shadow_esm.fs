@@ -0,0 +1,20 @@
+#version 330 core
+// exponential shadow map: each texel is the mean of exp(c * depth) over the
+// 2x2 depth texels under it; filtering and mipmapping it averages those, so
+// the receiver's exp(-c * depth) times it is a soft occlusion test
+#define ESM_C 80.0   // ShadowCascades::kEsmExponent
+
+uniform sampler2DArray depthLayers;   // the cascades' depth, compare off
+uniform int layer;
+
+out float esm;
+
+void main()
+{
+    ivec2 t = ivec2(gl_FragCoord.xy) * 2;
+    float e = 0.0;
+    for (int y = 0; y < 2; ++y)
+        for (int x = 0; x < 2; ++x)
+            e += exp(ESM_C * texelFetch(depthLayers, ivec3(t + ivec2(x, y), layer), 0).r);
+    esm = 0.25 * e;
+}
@@ -8,33 +8,40 @@ out vec4 FragColor;
 
 uniform sampler2D albedoMap;
 uniform sampler2D normalMap;
-uniform sampler2D shadowMap;         // unit 5
-uniform mat4      lightSpaceMatrix;
-
-// sun / directional
-uniform vec3 lightDir;   // normalized from above → down
-uniform vec3 lightColor;
-uniform float dayFactor;
-
-// camera & ambient
-uniform vec3 viewPos;
-uniform float ambientStrength;
-
-// fog
-uniform float fogStart;
-uniform float fogEnd;
-uniform vec3  fogColor;
-
-// water tint
-uniform float waterHeight;
-uniform float maxDepth;
-uniform vec3  shallowColor;
-uniform vec3  deepColor;
-uniform bool   shadowsEnabled;
+uniform sampler2DArrayShadow shadowMap;   // unit 5, one layer per cascade, hardware compare
+uniform sampler2DArray       shadowEsm;   // unit 9, exp(ESM_C * depth) with mipmaps
+
+// per-pass camera, shared by terrain/lit/water (ultis/frameUniforms.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec2 clusterDepth;   // light cluster slice = log(depth)*x - y
+};
+#define SHADOW_CASCADES 4   // kShadowCascades
+// per-frame sun, water tint and fog (ultis/frameUniforms.h)
+layout(std140) uniform Frame {
+    mat4  cascadeMatrices[SHADOW_CASCADES];   // world -> light clip space
+    vec4  cascadeBias;                        // depth bias per cascade
+    vec3  lightPos;      float dayFactor;
+    vec3  lightDir;      float ambientStrength;   // normalized, from the sun down
+    vec3  lightColor;    bool  shadowsEnabled;
+    vec3  shallowColor;  float waterHeight;
+    vec3  deepColor;     float maxDepth;
+    vec3  fogColor;      float fogStart;
+    float fogEnd;        int   shadowFilter;      // 0: PCF, 1: ESM
+};
 
 // spotlights
-#define MAX_SPOTLIGHTS 10
-uniform int          numSpotLights;
+// clustered: lights packed in a buffer, each view-space froxel lists the ones
+// reaching it (object/lightClusters.h; the grid size must match kTiles/kSlices)
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+uniform samplerBuffer  spotLightData;   // 5 texels per light
+uniform usamplerBuffer clusterGrid;     // first index, count per froxel
+uniform usamplerBuffer clusterLights;   // light indices grouped by froxel
+
 struct SpotLight {
     vec3 Position;
     vec3 Direction;
@@ -47,22 +54,58 @@ struct SpotLight {
     float Linear;
     float Quadratic;
 };
-uniform SpotLight spotLights[MAX_SPOTLIGHTS];
-
-// PCF shadow
-float ShadowCalculation(vec4 fragPosLightSpace, vec3 N) {
-    vec3 proj = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    proj = proj*0.5 + 0.5;
-    if(proj.z>1.0 || proj.x<0.0||proj.x>1.0||proj.y<0.0||proj.y>1.0) return 0.0;
-    float bias = max(0.05*(1.0 - dot(N, -lightDir)), 0.005);
-    float shadow = 0.0;
-    vec2 ts = 1.0/textureSize(shadowMap,0);
-    for(int x=-1;x<=1;++x)
-      for(int y=-1;y<=1;++y){
-        float pd = texture(shadowMap, proj.xy + vec2(x,y)*ts).r;
-        if(proj.z - bias > pd) shadow += 1.0;
+
+SpotLight fetchSpotLight(int i) {
+    vec4 t0 = texelFetch(spotLightData, i*5);
+    vec4 t1 = texelFetch(spotLightData, i*5 + 1);
+    vec4 t2 = texelFetch(spotLightData, i*5 + 2);
+    vec4 t3 = texelFetch(spotLightData, i*5 + 3);
+    vec4 t4 = texelFetch(spotLightData, i*5 + 4);
+    SpotLight l;
+    l.Position  = t0.xyz;  l.Constant    = t0.w;
+    l.Direction = t1.xyz;  l.Linear      = t1.w;
+    l.Ambient   = t2.xyz;  l.Quadratic   = t2.w;
+    l.Diffuse   = t3.xyz;  l.CutOff      = t3.w;
+    l.Specular  = t4.xyz;  l.OuterCutOff = t4.w;
+    return l;
+}
+
+// (first index, count) into clusterLights for the froxel holding worldPos
+uvec2 clusterRange(vec3 worldPos) {
+    vec4  viewP = view * vec4(worldPos, 1.0);
+    vec4  clip  = projection * viewP;
+    vec2  uv    = clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 0.999);
+    int   slice = clamp(int(floor(log(max(-viewP.z, 1e-4)) * clusterDepth.x - clusterDepth.y)), 0, CLUSTER_Z - 1);
+    ivec2 tile  = ivec2(uv * vec2(CLUSTER_X, CLUSTER_Y));
+    return texelFetch(clusterGrid, (slice*CLUSTER_Y + tile.y)*CLUSTER_X + tile.x).xy;
+}
+
+// shadow from the finest cascade that holds the fragment: four hardware
+// bilinear compares (PCF), or one trilinear ESM tap
+#define ESM_C 80.0   // ShadowCascades::kEsmExponent
+float ShadowCalculation(vec3 worldPos, vec3 N) {
+    // derivatives here, in uniform control flow, for the ESM mip
+    vec3 dx = dFdx(worldPos), dy = dFdy(worldPos);
+    vec2 ts = 1.0/vec2(textureSize(shadowMap,0).xy);
+    float slope = 1.0 - max(dot(N, -lightDir), 0.0);
+    for(int c=0;c<SHADOW_CASCADES;++c){
+      vec4 ls = cascadeMatrices[c] * vec4(worldPos, 1.0);
+      vec3 proj = ls.xyz/ls.w*0.5 + 0.5;
+      if(proj.z>1.0 || any(lessThan(proj.xy, ts)) || any(greaterThan(proj.xy, 1.0 - ts))) continue;
+      if(shadowFilter == 1){
+        vec2 gx = 0.5*(cascadeMatrices[c] * vec4(dx, 0.0)).xy;
+        vec2 gy = 0.5*(cascadeMatrices[c] * vec4(dy, 0.0)).xy;
+        float occ = textureGrad(shadowEsm, vec3(proj.xy, float(c)), gx, gy).r;
+        return 1.0 - clamp(occ * exp(-ESM_C * proj.z), 0.0, 1.0);
       }
-    return shadow/9.0;
+      float ref = proj.z - cascadeBias[c] * (1.0 + 2.0*slope);
+      float lit = 0.0;
+      for(int x=0;x<2;++x)
+        for(int y=0;y<2;++y)
+          lit += texture(shadowMap, vec4(proj.xy + (vec2(x,y) - 0.5)*ts, float(c), ref));
+      return 1.0 - lit*0.25;
+    }
+    return 0.0;
 }
 
 // same spotlight helper as above
@@ -110,18 +153,19 @@ void main(){
     }
 
     // 4) sun shadow
-    vec4 posLS = lightSpaceMatrix * vec4(WorldPos, 1.0);
     float shadow = 0.0;
     if (shadowsEnabled) {
-        shadow = ShadowCalculation(posLS, N);
+        shadow = ShadowCalculation(WorldPos, N);
     }
     // now blend only the non-ambient part with shadow
     vec3 sunContrib = ambient + (1.0 - shadow) * (lit - ambient);
 
     // 5) spotlights
     vec3 spotContrib = vec3(0.0);
-    for(int i=0;i<numSpotLights;++i){
-      spotContrib += CalcSpotLight(spotLights[i],N,WorldPos,V,alb);
+    uvec2 cl = clusterRange(WorldPos);
+    for(uint k=0u;k<cl.y;++k){
+      int li = int(texelFetch(clusterLights, int(cl.x + k)).r);
+      spotContrib += CalcSpotLight(fetchSpotLight(li),N,WorldPos,V,alb);
     }
 
     // 6) fog & gamma
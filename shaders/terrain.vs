@@ -1,33 +1,70 @@
 #version 330 core
 
-layout(location = 0) in vec3 aPos;      // local vertex position
-layout(location = 1) in vec3 aNormal;   // local vertex normal
+// packed 8-byte vertex (terrain/terrainVertex.h); x/z come from gl_VertexID
+layout(location = 0) in vec2 aHeight;     // height, parent LOD height (unorm16)
+layout(location = 1) in vec4 aOctNormal;  // normal.xy, parent LOD normal.zw (octahedral)
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-pass camera, shared by terrain/lit/water (ultis/frameUniforms.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec2 clusterDepth;   // light cluster slice = log(depth)*x - y
+};
 uniform float worldScale;    // == the total width/depth of your terrain
 uniform vec4  clipPlane;     // for water‐reflection/refraction
 
+// grid reconstruction (set per mesh / per node)
+uniform vec2  heightRange;   // min height, max-min
+uniform ivec2 patchInfo;     // vertices per row, base vertex of the draw
+uniform vec3  nodeXform;     // world x,z of the first vertex, vertex spacing
+
+// geomorphing (set by LodTerrain::Draw per node)
+uniform vec3 lodCameraPos;   // camera the LOD was selected for
+uniform vec2 morphRange;     // distance where morphing starts / is complete
+
 out vec3 WorldPos;
 out vec3 Normal;
 out vec2 UV;
 
+// inverse of octEncode: y is the folded (up) axis
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    // 1) Compute world‐space position
-    vec4 w = model * vec4(aPos,1.0);
+    // 0) rebuild the grid position; gl_VertexID includes the base vertex
+    int   id = gl_VertexID - patchInfo.y;
+    vec2  xz = nodeXform.xy + vec2(id % patchInfo.x, id / patchInfo.x) * nodeXform.z;
+    vec2  h  = heightRange.x + aHeight * heightRange.y;
+
+    // 1) blend towards the parent LOD as the node nears its merge distance,
+    //    so switching levels never pops
+    vec3  target = vec3(xz.x, h.y, xz.y);
+    float k = clamp((distance(lodCameraPos, target) - morphRange.x)
+                    / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec3 pos = vec3(xz.x, mix(h.x, h.y, k), xz.y);
+    vec3 nrm = normalize(mix(octDecode(aOctNormal.xy), octDecode(aOctNormal.zw), k));
+
+    // 2) Compute world‐space position
+    vec4 w = model * vec4(pos,1.0);
     WorldPos = w.xyz;
 
-    // 2) Clip plane for reflection/refraction passes
+    // 3) Clip plane for reflection/refraction passes
     gl_ClipDistance[0] = dot(w, clipPlane);
 
-    // 3) Transform normal to world‐space
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    // 4) Transform normal to world‐space
+    Normal = mat3(transpose(inverse(model))) * nrm;
 
-    // 4) Build a UV coordinate that covers [0..1] exactly once
+    // 5) Build a UV coordinate that covers [0..1] exactly once
     //    across worldScale in X and Z:
     UV = w.xz / worldScale;
 
-    // 5) Final vertex position
+    // 6) Final vertex position
     gl_Position = projection * view * w;
 }
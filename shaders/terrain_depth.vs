@@ -0,0 +1,25 @@
+#version 330 core
+// shadow_depth.vs for the packed terrain vertex: same grid rebuild and
+// geomorph as terrain.vs, so the shadow caster matches what is drawn
+layout(location = 0) in vec2 aHeight;     // height, parent LOD height (unorm16)
+
+uniform mat4 lightSpaceMatrix;
+uniform mat4 model;
+
+uniform vec2  heightRange;   // min height, max-min
+uniform ivec2 patchInfo;     // vertices per row, base vertex of the draw
+uniform vec3  nodeXform;     // world x,z of the first vertex, vertex spacing
+
+uniform vec3 lodCameraPos;
+uniform vec2 morphRange;
+
+void main()
+{
+    int   id = gl_VertexID - patchInfo.y;
+    vec2  xz = nodeXform.xy + vec2(id % patchInfo.x, id / patchInfo.x) * nodeXform.z;
+    vec2  h  = heightRange.x + aHeight * heightRange.y;
+
+    float k = clamp((distance(lodCameraPos, vec3(xz.x, h.y, xz.y)) - morphRange.x)
+                    / (morphRange.y - morphRange.x), 0.0, 1.0);
+    gl_Position = lightSpaceMatrix * model * vec4(xz.x, mix(h.x, h.y, k), xz.y, 1.0);
+}
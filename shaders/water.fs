@@ -11,9 +11,27 @@ uniform sampler2D texNormal;
 uniform sampler2D texDepthRefract;
 uniform samplerCube texSkybox;
 
-uniform vec3  eyePoint;
-uniform vec3  lightPos;
-uniform vec3  lightColor;
+// per-pass camera, shared by terrain/lit/water (ultis/frameUniforms.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec2 clusterDepth;   // light cluster slice = log(depth)*x - y
+};
+#define SHADOW_CASCADES 4   // kShadowCascades
+// per-frame sun, water tint and fog (ultis/frameUniforms.h)
+layout(std140) uniform Frame {
+    mat4  cascadeMatrices[SHADOW_CASCADES];   // world -> light clip space
+    vec4  cascadeBias;                        // depth bias per cascade
+    vec3  lightPos;      float dayFactor;
+    vec3  lightDir;      float ambientStrength;   // normalized, from the sun down
+    vec3  lightColor;    bool  shadowsEnabled;
+    vec3  shallowColor;  float waterHeight;
+    vec3  deepColor;     float maxDepth;
+    vec3  fogColor;      float fogStart;
+    float fogEnd;        int   shadowFilter;      // 0: PCF, 1: ESM
+};
+
 uniform float dudvMove;
 
 out vec4 fragColor;
@@ -70,7 +88,7 @@ void main() {
     vec4 refracted = mix(colRefr, waterColor, 0.5);
 
     // 7) Your original Fresnel mix
-    vec3 Vdir = normalize(eyePoint - worldPos);
+    vec3 Vdir = normalize(viewPos - worldPos);
     float Fmix = fresnelSchlick(max(dot(Vdir, vec3(0,1,0)), 0.0));
     vec4 base  = mix(refracted, colRefl, Fmix);
 
@@ -4,8 +4,13 @@ layout(location = 1) in vec2 vtxUv;
 layout(location = 2) in vec3 vtxN;
 
 uniform mat4 M;
-uniform mat4 V;
-uniform mat4 P;
+// per-pass camera, shared by terrain/lit/water (ultis/frameUniforms.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    vec2 clusterDepth;   // light cluster slice = log(depth)*x - y
+};
 
 out vec4 clipSpace;
 out vec2 uv;
@@ -17,7 +22,7 @@ void main() {
     worldPos = world.xyz;
     worldN   = normalize((inverse(transpose(M)) * vec4(vtxN,0.0)).xyz);
 
-    clipSpace = P * V * world;
+    clipSpace = projection * view * world;
     gl_Position = clipSpace;
 
     uv = vtxUv;
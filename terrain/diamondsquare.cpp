@@ -0,0 +1,132 @@
+#include "diamondsquare.h"
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <thread>
+#include <cmath>
+
+// counter-based random source: a stateless hash of (seed, x, z) mapped to [-1..1).
+// no shared generator state, so cells can be filled in any order.
+static inline std::uint32_t mixBits(std::uint32_t h){
+    h ^= h >> 16; h *= 0x7feb352du;
+    h ^= h >> 15; h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline float cellOffset(std::uint32_t seed, std::uint32_t x, std::uint32_t z){
+    std::uint32_t h = mixBits(seed ^ (x * 0x9e3779b9u));
+    h = mixBits(h ^ (z * 0x85ebca6bu));
+    return float(std::int32_t(h)) * (1.0f / 2147483648.0f);
+}
+
+// split [0,count) into contiguous row ranges, at most one per thread.
+// grain = minimum rows worth handing to a thread; small levels run inline.
+template<class Fn>
+static void parallelRows(std::size_t count, std::size_t grain, std::size_t threads, Fn&& fn){
+    std::size_t workers = std::min(threads, count / std::max<std::size_t>(grain,1));
+    if(workers <= 1){ fn(std::size_t(0), count); return; }
+
+    std::size_t chunk = (count + workers - 1) / workers;
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for(std::size_t w=1; w<workers; ++w){
+        std::size_t b = w*chunk, e = std::min(count, b+chunk);
+        if(b < e) pool.emplace_back([&fn,b,e]{ fn(b,e); });
+    }
+    fn(std::size_t(0), std::min(count, chunk));
+    for(auto& t:pool) t.join();
+}
+
+// rows of one level are only worth a thread once they hold this many cells
+static const std::size_t kCellsPerThread = 1u << 14;
+
+// the fill is written once against an index functor: row-major gets a plain
+// z*N+x the compiler can vectorize, tiled/morton go through Heightfield::index
+template<class Idx>
+static void fill(float* h, std::size_t size, float smoothness, std::uint32_t seed,
+                 std::uint32_t ox, std::uint32_t oz, std::size_t threads, Idx idx){
+    // offsets are hashed on global cell coordinates
+    auto rnd=[&](std::size_t x, std::size_t z){
+        return cellOffset(seed, ox + std::uint32_t(x), oz + std::uint32_t(z));
+    };
+
+    h[idx(0,0)]       = rnd(0,    0);
+    h[idx(size,0)]    = rnd(size, 0);
+    h[idx(0,size)]    = rnd(0,    size);
+    h[idx(size,size)] = rnd(size, size);
+
+    int steps = int(std::log2(size));
+    for(int d=1; d<=steps; ++d){
+        std::size_t step = size >> (d-1), half = step >> 1;
+        float r = std::pow(2.0f, -smoothness * float(d));
+        std::size_t perRow = size / step;
+        std::size_t grain  = kCellsPerThread / perRow + 1;
+
+        // diamond: every centre reads four corners from the previous level
+        parallelRows(size/step, grain, threads, [&](std::size_t j0, std::size_t j1){
+            for(std::size_t j=j0; j<j1; ++j){
+                std::size_t y = j*step;
+                for(std::size_t x=0; x<size; x+=step){
+                    float avg = (h[idx(x,y)] + h[idx(x+step,y)]
+                               + h[idx(x,y+step)] + h[idx(x+step,y+step)]) * 0.25f;
+                    h[idx(x+half,y+half)] = avg + rnd(x+half, y+half) * r;
+                }
+            }
+        });
+
+        // square: edge midpoints read corners and this level's centres only,
+        // never another midpoint, so rows are independent
+        parallelRows(size/half + 1, grain, threads, [&](std::size_t j0, std::size_t j1){
+            for(std::size_t j=j0; j<j1; ++j){
+                std::size_t y = j*half;
+                if(j & 1){
+                    // row of centres: x = 0, step, ..., size.
+                    // the left/right borders only see their own edge (1-D
+                    // midpoint displacement) so adjacent tiles agree on it
+                    h[idx(0,y)] = (h[idx(0,y-half)] + h[idx(0,y+half)]) * 0.5f
+                                + rnd(0, y) * r;
+                    for(std::size_t x=step; x<size; x+=step){
+                        float avg = (h[idx(x-half,y)] + h[idx(x+half,y)]
+                                   + h[idx(x,y-half)] + h[idx(x,y+half)]) * 0.25f;
+                        h[idx(x,y)] = avg + rnd(x, y) * r;
+                    }
+                    h[idx(size,y)] = (h[idx(size,y-half)] + h[idx(size,y+half)]) * 0.5f
+                                   + rnd(size, y) * r;
+                } else if(y == 0 || y == size){
+                    // top/bottom border: along the edge only, as above
+                    for(std::size_t x=half; x<size; x+=step){
+                        float avg = (h[idx(x-half,y)] + h[idx(x+half,y)]) * 0.5f;
+                        h[idx(x,y)] = avg + rnd(x, y) * r;
+                    }
+                } else {
+                    // row of corners: x = half, half+step, ..., size-half
+                    for(std::size_t x=half; x<size; x+=step){
+                        float avg = (h[idx(x-half,y)] + h[idx(x+half,y)]
+                                   + h[idx(x,y-half)] + h[idx(x,y+half)]) * 0.25f;
+                        h[idx(x,y)] = avg + rnd(x, y) * r;
+                    }
+                }
+            }
+        });
+    }
+}
+
+void generateDiamondSquare(Heightfield& hf, float smoothness, std::uint32_t seed,
+                           std::int32_t cellX, std::int32_t cellZ, unsigned threads){
+    std::size_t size = hf.gridSize() - 1;
+    if(hf.gridSize() < 2 || (size & (size-1)))
+        throw std::invalid_argument("size must be power of two");
+    static const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t maxThreads = threads ? threads : hw;
+
+    if(hf.layout() == Heightfield::Layout::RowMajor){
+        std::size_t N = hf.gridSize();
+        fill(hf.data(), size, smoothness, seed, std::uint32_t(cellX), std::uint32_t(cellZ), maxThreads,
+             [N](std::size_t x, std::size_t z){ return z*N + x; });
+    } else {
+        const Heightfield& c = hf;
+        fill(hf.data(), size, smoothness, seed, std::uint32_t(cellX), std::uint32_t(cellZ), maxThreads,
+             [&c](std::size_t x, std::size_t z){ return c.index(x,z); });
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef DIAMOND_SQUARE_H
+#define DIAMOND_SQUARE_H
+
+#include <cstdint>
+#include "heightfield.h"
+
+// Full diamond–square fractal written in place into hf, whose gridSize()-1
+// must be a power of two. Every random offset is a pure function of
+// (seed, x, z), so the diamond and square steps run in parallel over rows and
+// the same seed gives the same heightmap at any thread count and any layout.
+// Heights are in roughly [-1..1].
+// cellX/cellZ place the grid in a larger world: offsets are hashed on global
+// cell coordinates and the four borders are filled from their own edge only,
+// so grids generated at (k*size, m*size) tile without seams.
+// threads caps the row split (0 = one per hardware thread); callers already
+// running on a worker pool pass 1.
+void generateDiamondSquare(Heightfield& hf, float smoothness, std::uint32_t seed,
+                           std::int32_t cellX = 0, std::int32_t cellZ = 0,
+                           unsigned threads = 0);
+
+#endif // DIAMOND_SQUARE_H
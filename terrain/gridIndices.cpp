@@ -0,0 +1,66 @@
+#include "gridIndices.h"
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// quads per band: two band rows (2*(kBand+1) vertices) fit even a 16-entry
+// FIFO vertex cache, so each vertex is transformed about once instead of
+// twice as with full-width rows (simulated ACMR ~0.6 vs ~1.0 for 16-32 entries)
+static const std::size_t kBand = 7;
+
+namespace {
+struct Entry {
+    GridIndexBuffer buf;
+    int             refs = 0;
+};
+std::map<std::size_t, Entry>& cache(){
+    static std::map<std::size_t, Entry> c;
+    return c;
+}
+}
+
+template<class T>
+static std::vector<T> buildIndices(std::size_t res){
+    std::size_t V = res+1;
+    std::vector<T> idx;
+    idx.reserve(res*res*6);
+    for(std::size_t bx=0; bx<res; bx+=kBand){
+        std::size_t ex = std::min(bx+kBand, res);
+        for(std::size_t z=0; z<res; ++z){
+          for(std::size_t x=bx; x<ex; ++x){
+            T tl=T(z*V+x), tr=T(tl+1), bl=T(tl+V), br=T(bl+1);
+            idx.insert(idx.end(),{tl,bl,tr,tr,bl,br});
+          }
+        }
+    }
+    return idx;
+}
+
+GridIndexBuffer acquireGridIndices(std::size_t res){
+    Entry& e = cache()[res];
+    if(e.refs++ > 0) return e.buf;
+
+    glGenBuffers(1,&e.buf.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,e.buf.ebo);
+    if((res+1)*(res+1) <= 0x10000){
+        auto idx = buildIndices<GLushort>(res);
+        e.buf.type  = GL_UNSIGNED_SHORT;
+        e.buf.count = GLsizei(idx.size());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,idx.size()*sizeof(GLushort),idx.data(),GL_STATIC_DRAW);
+    } else {
+        auto idx = buildIndices<GLuint>(res);
+        e.buf.type  = GL_UNSIGNED_INT;
+        e.buf.count = GLsizei(idx.size());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,idx.size()*sizeof(GLuint),idx.data(),GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    return e.buf;
+}
+
+void releaseGridIndices(std::size_t res){
+    auto it = cache().find(res);
+    if(it == cache().end() || --it->second.refs > 0) return;
+    glDeleteBuffers(1,&it->second.buf.ebo);
+    cache().erase(it);
+}
@@ -0,0 +1,24 @@
+#ifndef GRID_INDICES_H
+#define GRID_INDICES_H
+
+#include <cstddef>
+#include "../lib/glad.h"
+
+// Index buffer for a res x res quad grid over (res+1)^2 row-major vertices,
+// shared by every mesh of that resolution (all LodTerrain tiles and nodes,
+// Terrain). Quads keep the tl/bl/tr + tr/bl/br split the geomorph relies on,
+// but are emitted in vertical bands narrow enough that one band row still
+// sits in the post-transform cache when the next row reuses it.
+// 16-bit indices whenever (res+1)^2 fits.
+struct GridIndexBuffer {
+    GLuint  ebo   = 0;
+    GLsizei count = 0;                 // indices, GL_TRIANGLES
+    GLenum  type  = GL_UNSIGNED_INT;   // or GL_UNSIGNED_SHORT
+};
+
+// refcounted per resolution; GL thread only.
+// acquire builds and uploads on first use, release frees after the last user.
+GridIndexBuffer acquireGridIndices(std::size_t res);
+void            releaseGridIndices(std::size_t res);
+
+#endif // GRID_INDICES_H
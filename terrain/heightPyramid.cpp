@@ -0,0 +1,140 @@
+#include "heightPyramid.h"
+#include <algorithm>
+#include <cmath>
+
+HeightPyramid::HeightPyramid(const Heightfield& hf){
+    std::size_t N = hf.gridSize()-1;
+    if(hf.gridSize() < 2) return;
+
+    Level base;
+    base.dim = N;
+    base.lo.resize(N*N); base.hi.resize(N*N);
+    for(std::size_t z=0;z<N;++z){
+      for(std::size_t x=0;x<N;++x){
+        float a=hf.at(x,z), b=hf.at(x+1,z), c=hf.at(x,z+1), d=hf.at(x+1,z+1);
+        base.lo[z*N+x] = std::min(std::min(a,b),std::min(c,d));
+        base.hi[z*N+x] = std::max(std::max(a,b),std::max(c,d));
+      }
+    }
+    _levels.push_back(std::move(base));
+
+    while(_levels.back().dim > 1){
+        const Level& f = _levels.back();
+        Level c;
+        c.dim = f.dim/2;
+        c.lo.resize(c.dim*c.dim); c.hi.resize(c.dim*c.dim);
+        for(std::size_t z=0;z<c.dim;++z){
+          for(std::size_t x=0;x<c.dim;++x){
+            std::size_t i = 2*z*f.dim + 2*x;
+            c.lo[z*c.dim+x] = std::min(std::min(f.lo[i],f.lo[i+1]),std::min(f.lo[i+f.dim],f.lo[i+f.dim+1]));
+            c.hi[z*c.dim+x] = std::max(std::max(f.hi[i],f.hi[i+1]),std::max(f.hi[i+f.dim],f.hi[i+f.dim+1]));
+          }
+        }
+        _levels.push_back(std::move(c));
+    }
+}
+
+glm::vec2 HeightPyramid::blockRange(std::size_t x0, std::size_t z0, std::size_t w) const {
+    int level = 0;
+    while((std::size_t(1) << level) < w) ++level;
+    const Level& L = _levels[std::min(level, levels()-1)];
+    std::size_t i = (z0 >> level)*L.dim + (x0 >> level);
+    return glm::vec2(L.lo[i], L.hi[i]);
+}
+
+glm::vec2 HeightPyramid::rectRange(std::size_t x0, std::size_t z0, std::size_t x1, std::size_t z1) const {
+    // blocks of at least a quarter of the rect: at most 5x5 of them cover it
+    std::size_t ext = std::max<std::size_t>(std::max(x1-x0, z1-z0), 1);
+    int level = 0;
+    while((std::size_t(4) << level) < ext && level < levels()-1) ++level;
+    const Level& L = _levels[level];
+    glm::vec2 r(1e30f, -1e30f);
+    for(std::size_t bz = z0 >> level; bz <= ((z1-1) >> level) && bz < L.dim; ++bz){
+      for(std::size_t bx = x0 >> level; bx <= ((x1-1) >> level) && bx < L.dim; ++bx){
+        r.x = std::min(r.x, L.lo[bz*L.dim+bx]);
+        r.y = std::max(r.y, L.hi[bz*L.dim+bx]);
+      }
+    }
+    return r;
+}
+
+// slab test; [t0,t1] is narrowed to the part of the ray inside the box
+static bool rayBox(const glm::vec3& o, const glm::vec3& d,
+                   const glm::vec3& lo, const glm::vec3& hi, float& t0, float& t1){
+    for(int a=0;a<3;++a){
+        if(std::abs(d[a]) < 1e-12f){
+            if(o[a] < lo[a] || o[a] > hi[a]) return false;
+            continue;
+        }
+        float inv = 1.0f/d[a];
+        float ta = (lo[a]-o[a])*inv, tb = (hi[a]-o[a])*inv;
+        if(ta > tb) std::swap(ta,tb);
+        t0 = std::max(t0,ta); t1 = std::min(t1,tb);
+        if(t0 > t1) return false;
+    }
+    return true;
+}
+
+// Möller–Trumbore, two-sided
+static bool rayTriangle(const glm::vec3& o, const glm::vec3& d,
+                        const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t){
+    glm::vec3 e1 = b-a, e2 = c-a, p = glm::cross(d,e2);
+    float det = glm::dot(e1,p);
+    if(std::abs(det) < 1e-12f) return false;
+    float inv = 1.0f/det;
+    glm::vec3 s = o-a;
+    float u = glm::dot(s,p)*inv;
+    if(u < 0.0f || u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s,e1);
+    float v = glm::dot(d,q)*inv;
+    if(v < 0.0f || u+v > 1.0f) return false;
+    t = glm::dot(e2,q)*inv;
+    return true;
+}
+
+bool HeightPyramid::raycast(const Heightfield& hf, const glm::vec3& o, const glm::vec3& d,
+                            float tMax, float& tHit) const {
+    if(empty()) return false;
+    float best = tMax;
+    bool found = false;
+
+    struct Item { int level; std::size_t x, z; float tEnter; };
+    std::vector<Item> stack;
+    stack.reserve(4*levels());
+
+    auto push=[&](int level, std::size_t x, std::size_t z){
+        const Level& L = _levels[level];
+        std::size_t w = std::size_t(1) << level, i = z*L.dim + x;
+        float t0 = 0.0f, t1 = best;
+        if(rayBox(o, d, glm::vec3(float(x*w), L.lo[i], float(z*w)),
+                        glm::vec3(float((x+1)*w), L.hi[i], float((z+1)*w)), t0, t1))
+            stack.push_back({level, x, z, t0});
+    };
+    push(levels()-1, 0, 0);
+
+    while(!stack.empty()){
+        Item it = stack.back();
+        stack.pop_back();
+        if(it.tEnter > best) continue;
+
+        if(it.level == 0){
+            glm::vec3 tl(float(it.x),   hf.at(it.x,  it.z),   float(it.z));
+            glm::vec3 tr(float(it.x+1), hf.at(it.x+1,it.z),   float(it.z));
+            glm::vec3 bl(float(it.x),   hf.at(it.x,  it.z+1), float(it.z+1));
+            glm::vec3 br(float(it.x+1), hf.at(it.x+1,it.z+1), float(it.z+1));
+            float t;
+            if(rayTriangle(o,d,tl,bl,tr,t) && t >= 0.0f && t <= best){ best = t; found = true; }
+            if(rayTriangle(o,d,tr,bl,br,t) && t >= 0.0f && t <= best){ best = t; found = true; }
+            continue;
+        }
+
+        // children, nearest entry popped first
+        std::size_t before = stack.size();
+        for(int c=0;c<4;++c) push(it.level-1, 2*it.x + (c&1), 2*it.z + (c>>1));
+        std::sort(stack.begin()+before, stack.end(),
+                  [](const Item& a, const Item& b){ return a.tEnter > b.tEnter; });
+    }
+
+    if(found) tHit = best;
+    return found;
+}
@@ -0,0 +1,42 @@
+#ifndef HEIGHT_PYRAMID_H
+#define HEIGHT_PYRAMID_H
+
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "heightfield.h"
+
+// Min/max mip chain over the cells of a (N+1)^2 heightfield, N a power of two.
+// Level 0 has one entry per grid cell (min/max of its 4 corners), each level
+// above halves the cells per side, the last level is a single cell.
+// Everything is in grid space: x/z in cells, y in heightfield units.
+class HeightPyramid {
+public:
+    HeightPyramid() = default;
+    explicit HeightPyramid(const Heightfield& hf);
+
+    bool        empty()  const { return _levels.empty(); }
+    int         levels() const { return int(_levels.size()); }
+    std::size_t cells(int level) const { return _levels[level].dim; }
+
+    // (min, max) of the aligned block of w x w cells at (x0, z0);
+    // w a power of two, x0/z0 multiples of w
+    glm::vec2 blockRange(std::size_t x0, std::size_t z0, std::size_t w) const;
+    // conservative (min, max) over cells [x0,x1) x [z0,z1), any extent
+    glm::vec2 rectRange(std::size_t x0, std::size_t z0, std::size_t x1, std::size_t z1) const;
+
+    // First hit of o + t*d with the triangulated surface (the tl/bl/tr +
+    // tr/bl/br split the meshes use), t in [0, tMax]. Descends the pyramid,
+    // skipping every block whose box the ray misses.
+    bool raycast(const Heightfield& hf, const glm::vec3& o, const glm::vec3& d,
+                 float tMax, float& tHit) const;
+
+private:
+    struct Level {
+        std::size_t        dim = 0;     // cells per side
+        std::vector<float> lo, hi;      // dim*dim, row-major
+    };
+    std::vector<Level> _levels;
+};
+
+#endif // HEIGHT_PYRAMID_H
@@ -0,0 +1,87 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+// Square grid of heights in one contiguous buffer.
+// RowMajor: plain z*N+x.
+// Tiled:    16x16 blocks stored back to back, row-major inside a block, so
+//           the vertical neighbours read by the square step and the normal
+//           pass sit in the same few cache lines.
+// Morton:   same blocks, Z-order inside a block.
+// Blocks pad the buffer up to a multiple of 16 per side (<1% for 2^k+1 grids).
+class Heightfield {
+public:
+    enum class Layout { RowMajor, Tiled, Morton };
+
+    Heightfield() = default;
+    explicit Heightfield(std::size_t gridSize, Layout layout = Layout::RowMajor)
+      : _gridSize(gridSize), _layout(layout)
+    {
+        if(_layout == Layout::RowMajor){
+            _data.resize(gridSize*gridSize);
+        } else {
+            _blocksPerRow = (gridSize + kBlock - 1) / kBlock;
+            _data.resize(_blocksPerRow*_blocksPerRow*kBlock*kBlock);
+        }
+    }
+
+    std::size_t gridSize() const { return _gridSize; }
+    Layout      layout()   const { return _layout; }
+    bool        empty()    const { return _data.empty(); }
+
+    // raw storage (includes block padding for Tiled/Morton)
+    float*       data()       { return _data.data(); }
+    const float* data() const { return _data.data(); }
+    std::size_t  storageSize() const { return _data.size(); }
+
+    std::size_t index(std::size_t x, std::size_t z) const {
+        if(_layout == Layout::RowMajor) return z*_gridSize + x;
+        std::size_t block = (z >> kShift)*_blocksPerRow + (x >> kShift);
+        std::size_t lx = x & (kBlock-1), lz = z & (kBlock-1);
+        std::size_t local = _layout == Layout::Tiled
+                          ? (lz << kShift) + lx
+                          : spread(lx) | (spread(lz) << 1);
+        return (block << (2*kShift)) + local;
+    }
+
+    float& at(std::size_t x, std::size_t z)       { return _data[index(x,z)]; }
+    float  at(std::size_t x, std::size_t z) const { return _data[index(x,z)]; }
+
+    // bilinear lookup in grid units, clamped to the edges
+    float sample(float gx, float gz) const {
+        float maxC = float(_gridSize-1);
+        gx = std::min(std::max(gx, 0.0f), maxC);
+        gz = std::min(std::max(gz, 0.0f), maxC);
+        std::size_t x0 = std::size_t(gx), z0 = std::size_t(gz);
+        std::size_t x1 = std::min(x0+1, _gridSize-1);
+        std::size_t z1 = std::min(z0+1, _gridSize-1);
+        float sx = gx - float(x0), sz = gz - float(z0);
+        float a = at(x0,z0) + (at(x1,z0) - at(x0,z0))*sx;
+        float b = at(x0,z1) + (at(x1,z1) - at(x0,z1))*sx;
+        return a + (b - a)*sz;
+    }
+
+    // in-place multiply, padding included (it is never read)
+    void scale(float s){
+        for(float& h:_data) h *= s;
+    }
+
+private:
+    static constexpr std::size_t kShift = 4;
+    static constexpr std::size_t kBlock = std::size_t(1) << kShift;
+
+    // 0b0000abcd -> 0b0a0b0c0d
+    static std::size_t spread(std::size_t v){
+        return (v&1) | ((v&2)<<1) | ((v&4)<<2) | ((v&8)<<3);
+    }
+
+    std::size_t        _gridSize = 0;
+    std::size_t        _blocksPerRow = 0;
+    Layout             _layout = Layout::RowMajor;
+    std::vector<float> _data;
+};
+
+#endif // HEIGHTFIELD_H
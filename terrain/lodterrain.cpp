@@ -1,104 +1,234 @@
 #include "lodterrain.h"
+#include "diamondsquare.h"
+#include "../ultis/frustum.h"
 #include <glm/gtc/matrix_transform.hpp>
-#include "../lib/stb_image.h"
-#include <future>
-#include <random>
 #include <iostream>
+#include <fstream>
+#include <filesystem>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 //helper function
 float LodTerrain::getHeightAt(float worldX, float worldZ) const {
-    // we only have one tile in this version
-    const auto& tile = _tiles[0];
-
-    // map from world coords into [0..1] over the tile’s XZ‐extent
-    float u = (worldX - tile.origin.x) / _scale;
-    float v = (worldZ - tile.origin.z) / _scale;
-    u = glm::clamp(u, 0.0f, 1.0f);
-    v = glm::clamp(v, 0.0f, 1.0f);
-
-    // now map into heightmap grid coordinates
-    float gx = u * (tile.gridSize - 1);
-    float gz = v * (tile.gridSize - 1);
-    int x0 = int(floor(gx)), z0 = int(floor(gz));
-    int x1 = std::min(x0+1, int(tile.gridSize-1));
-    int z1 = std::min(z0+1, int(tile.gridSize-1));
-    float sx = gx - x0, sz = gz - z0;
-
-    // fetch the four corner heights
-    const auto& H = tile.heightmap;
-    float h00 = H[z0 * tile.gridSize + x0];
-    float h10 = H[z0 * tile.gridSize + x1];
-    float h01 = H[z1 * tile.gridSize + x0];
-    float h11 = H[z1 * tile.gridSize + x1];
-
-    // bilinear interpolation
-    float a = glm::mix(h00, h10, sx);
-    float b = glm::mix(h01, h11, sx);
-    float height = glm::mix(a, b, sz);
-
-    // add the base‐level Y offset
-    return height + tile.origin.y;
+    glm::vec2 p(worldX, worldZ);
+    float h;
+    getHeightsAt(&p, 1, &h);
+    return h;
 }
 
 glm::vec3 LodTerrain::getNormalAt(float worldX, float worldZ) const {
-    // small delta in world units for derivative
-    float d = _scale / float(_tileSize * 10);
-    // sample neighbors
-    float hl = getHeightAt(worldX - d, worldZ);
-    float hr = getHeightAt(worldX + d, worldZ);
-    float hd = getHeightAt(worldX, worldZ - d);
-    float hu = getHeightAt(worldX, worldZ + d);
-
-    // build tangent & bitangent vectors
-    glm::vec3 tan{ 2*d, hr - hl, 0.0f };
-    glm::vec3 bit{ 0.0f, hu - hd, 2*d };
-    return glm::normalize(glm::cross(tan, bit));
-}
-
-
-// diamond–square helper
-static float getH(float s, std::size_t d, std::mt19937& g) {
-    std::uniform_real_distribution<> dis(-1.0,1.0);
-    float sign = dis(g)>0 ? 1.0f : -1.0f;
-    float r = std::pow(2.0f, -s * float(d));
-    return sign * std::abs(dis(g)) * r;
-}
-
-// generate full (2^k+1)^2 fractal
-static std::vector<std::vector<float>> generateTerrain(std::size_t size, float smoothness){
-    if(size&(size-1)) throw std::invalid_argument("size must be power of two");
-    std::size_t N = size+1;
-    std::vector<std::vector<float>> m(N, std::vector<float>(N));
-    std::mt19937 gen(1337);
-    std::uniform_real_distribution<> dis(-1,1);
-
-    m[0][0]=dis(gen); m[0][size]=dis(gen);
-    m[size][0]=dis(gen); m[size][size]=dis(gen);
-
-    int steps = std::log2(size);
-    for(int d=1; d<=steps; ++d){
-        std::size_t step = size>>(d-1), half=step>>1;
-        // diamond
-        for(std::size_t y=0; y<size; y+=step){
-            for(std::size_t x=0; x<size; x+=step){
-                float avg = (m[y][x]+m[y][x+step]+m[y+step][x]+m[y+step][x+step])*0.25f;
-                m[y+half][x+half] = avg + getH(smoothness,d,gen);
+    glm::vec2 p(worldX, worldZ);
+    float h;
+    glm::vec3 n;
+    getHeightsAt(&p, 1, &h, &n);
+    return n;
+}
+
+void LodTerrain::getHeightsAt(const glm::vec2* xz, std::size_t count,
+                              float* heights, glm::vec3* normals) const {
+    std::size_t i = 0;
+    while(i < count){
+        // consecutive points in the same tile are sampled as one run
+        int ix = tileCoord(xz[i].x), iz = tileCoord(xz[i].y);
+        std::size_t end = i+1;
+        while(end < count && tileCoord(xz[end].x) == ix && tileCoord(xz[end].y) == iz) ++end;
+
+        auto it = _tiles.find(tileKey(ix, iz));
+        if(it == _tiles.end()){
+            // not streamed in: flat ground at the base level
+            for(std::size_t k=i;k<end;++k){
+                heights[k] = _yOffset;
+                if(normals) normals[k] = glm::vec3(0,1,0);
             }
+        } else {
+            sampleTile(it->second, xz+i, end-i, heights+i, normals ? normals+i : nullptr);
+        }
+        i = end;
+    }
+}
+
+// bilinear heights and normals inside one tile. the heightmap is always
+// row-major here; normals come from the precomputed x/z grids, y is rebuilt
+// (heightfield normals always point up). 4 points per SSE step, the corner
+// fetches are scalar (no gather before AVX2), the rest is vector math.
+void LodTerrain::sampleTile(const Tile& tile, const glm::vec2* xz, std::size_t count,
+                            float* heights, glm::vec3* normals) const {
+    const std::size_t G = tile.heightmap.gridSize();
+    const float* H  = tile.heightmap.data();
+    const float* NX = tile.normalX.data();
+    const float* NZ = tile.normalZ.data();
+    const float maxC = float(G-1), toGrid = maxC/_scale;
+
+    auto scalar=[&](std::size_t k){
+        float gx = std::min(std::max((xz[k].x - tile.origin.x)*toGrid, 0.0f), maxC);
+        float gz = std::min(std::max((xz[k].y - tile.origin.z)*toGrid, 0.0f), maxC);
+        float fx = std::min(std::floor(gx), maxC-1.0f), fz = std::min(std::floor(gz), maxC-1.0f);
+        float sx = gx - fx, sz = gz - fz;
+        std::size_t c = std::size_t(fz)*G + std::size_t(fx);
+        auto lerp2=[&](const float* f){
+            float a = f[c]   + (f[c+1]   - f[c])  *sx;
+            float b = f[c+G] + (f[c+G+1] - f[c+G])*sx;
+            return a + (b - a)*sz;
+        };
+        heights[k] = lerp2(H) + tile.origin.y;
+        if(normals){
+            float nx = lerp2(NX), nz = lerp2(NZ);
+            float ny = std::sqrt(std::max(1.0f - nx*nx - nz*nz, 0.0f));
+            normals[k] = glm::normalize(glm::vec3(nx, ny, nz));
         }
-        // square
-        for(std::size_t y=0; y<=size; y+=half){
-            for(std::size_t x=(y+half)%step; x<=size; x+=step){
-                float sum=0; int cnt=0;
-                if(x>=half){sum+=m[y][x-half];++cnt;}
-                if(x+half<=size){sum+=m[y][x+half];++cnt;}
-                if(y>=half){sum+=m[y-half][x];++cnt;}
-                if(y+half<=size){sum+=m[y+half][x];++cnt;}
-                m[y][x] = sum/cnt + getH(smoothness,d,gen);
+    };
+
+    std::size_t k = 0;
+#if defined(__SSE2__)
+    const __m128 ox = _mm_set1_ps(tile.origin.x), oz = _mm_set1_ps(tile.origin.z);
+    const __m128 oy = _mm_set1_ps(tile.origin.y);
+    const __m128 vToGrid = _mm_set1_ps(toGrid), vMax = _mm_set1_ps(maxC);
+    const __m128 vLast = _mm_set1_ps(maxC-1.0f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    alignas(16) std::int32_t cx[4], cz[4];
+    for(; k+4 <= count; k+=4){
+        // x0 z0 x1 z1 | x2 z2 x3 z3 -> x0..x3, z0..z3
+        __m128 a = _mm_loadu_ps(&xz[k].x), b = _mm_loadu_ps(&xz[k+2].x);
+        __m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+        __m128 z = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+
+        __m128 gx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(x, ox), vToGrid), zero), vMax);
+        __m128 gz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(z, oz), vToGrid), zero), vMax);
+        // gx >= 0, so truncation is floor
+        __m128 fx = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gx)), vLast);
+        __m128 fz = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gz)), vLast);
+        __m128 sx = _mm_sub_ps(gx, fx), sz = _mm_sub_ps(gz, fz);
+        _mm_store_si128(reinterpret_cast<__m128i*>(cx), _mm_cvttps_epi32(fx));
+        _mm_store_si128(reinterpret_cast<__m128i*>(cz), _mm_cvttps_epi32(fz));
+
+        std::size_t c[4];
+        for(int l=0;l<4;++l) c[l] = std::size_t(cz[l])*G + std::size_t(cx[l]);
+        auto bilerp=[&](const float* f){
+            __m128 f00 = _mm_setr_ps(f[c[0]],     f[c[1]],     f[c[2]],     f[c[3]]);
+            __m128 f10 = _mm_setr_ps(f[c[0]+1],   f[c[1]+1],   f[c[2]+1],   f[c[3]+1]);
+            __m128 f01 = _mm_setr_ps(f[c[0]+G],   f[c[1]+G],   f[c[2]+G],   f[c[3]+G]);
+            __m128 f11 = _mm_setr_ps(f[c[0]+G+1], f[c[1]+G+1], f[c[2]+G+1], f[c[3]+G+1]);
+            __m128 top = _mm_add_ps(f00, _mm_mul_ps(_mm_sub_ps(f10, f00), sx));
+            __m128 bot = _mm_add_ps(f01, _mm_mul_ps(_mm_sub_ps(f11, f01), sx));
+            return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bot, top), sz));
+        };
+        _mm_storeu_ps(heights+k, _mm_add_ps(bilerp(H), oy));
+
+        if(normals){
+            __m128 nx = bilerp(NX), nz = bilerp(NZ);
+            __m128 ny = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one,
+                            _mm_add_ps(_mm_mul_ps(nx,nx), _mm_mul_ps(nz,nz))), zero));
+            __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+                            _mm_mul_ps(nx,nx), _mm_mul_ps(ny,ny)), _mm_mul_ps(nz,nz))));
+            alignas(16) float rx[4], ry[4], rz[4];
+            _mm_store_ps(rx, _mm_mul_ps(nx, inv));
+            _mm_store_ps(ry, _mm_mul_ps(ny, inv));
+            _mm_store_ps(rz, _mm_mul_ps(nz, inv));
+            for(int l=0;l<4;++l) normals[k+l] = glm::vec3(rx[l], ry[l], rz[l]);
+        }
+    }
+#endif
+    for(; k<count; ++k) scalar(k);
+}
+
+void LodTerrain::buildNormalGrid(Tile& tile, const BorderedHeights& B) const {
+    // full-resolution central differences; the border ones reach into the
+    // neighbours, so both sides of a seam get the same normal
+    std::size_t G = tile.heightmap.gridSize();
+    float cell = _scale/float(G-1);
+    tile.normalX.resize(G*G);
+    tile.normalZ.resize(G*G);
+    for(std::size_t z=0;z<G;++z){
+      for(std::size_t x=0;x<G;++x){
+        long X = long(x), Z = long(z);
+        glm::vec3 tan{2.0f*cell, B.at(X+1,Z)-B.at(X-1,Z), 0};
+        glm::vec3 bit{0, B.at(X,Z+1)-B.at(X,Z-1), 2.0f*cell};
+        glm::vec3 n = glm::normalize(glm::cross(bit,tan));
+        tile.normalX[z*G+x] = n.x;
+        tile.normalZ[z*G+x] = n.z;
+      }
+    }
+}
+
+
+bool LodTerrain::raycast(const glm::vec3& origin, const glm::vec3& dir,
+                         TerrainHit& hit, float maxDistance) const {
+    float len = glm::length(dir);
+    if(len <= 0.0f || _tiles.empty()) return false;
+    glm::vec3 d = dir/len;
+
+    // walk the tile grid along the ray (2D DDA) and stop at the first tile
+    // with a hit; tiles that are not loaded are skipped
+    glm::vec2 p(origin.x/_scale + 0.5f, origin.z/_scale + 0.5f);   // tile units
+    int ix = int(std::floor(p.x)), iz = int(std::floor(p.y));
+    int stepX = d.x >= 0 ? 1 : -1, stepZ = d.z >= 0 ? 1 : -1;
+    float dtX = std::abs(d.x) > 1e-9f ? _scale/std::abs(d.x) : 1e30f;
+    float dtZ = std::abs(d.z) > 1e-9f ? _scale/std::abs(d.z) : 1e30f;
+    float tX = std::abs(d.x) > 1e-9f ? ((stepX > 0 ? ix+1-p.x : p.x-ix))*dtX : 1e30f;
+    float tZ = std::abs(d.z) > 1e-9f ? ((stepZ > 0 ? iz+1-p.y : p.y-iz))*dtZ : 1e30f;
+    float tIn = 0.0f;
+
+    while(tIn <= maxDistance){
+        auto it = _tiles.find(tileKey(ix, iz));
+        if(it != _tiles.end() && !it->second.pyramid.empty()){
+            const Tile& t = it->second;
+            // grid space is a per-axis scale of world space, so t carries over
+            float toGrid = float(t.heightmap.gridSize()-1)/_scale;
+            glm::vec3 o((origin.x-t.origin.x)*toGrid, origin.y-t.origin.y, (origin.z-t.origin.z)*toGrid);
+            glm::vec3 g(d.x*toGrid, d.y, d.z*toGrid);
+            float th;
+            if(t.pyramid.raycast(t.heightmap, o, g, std::min(std::min(tX,tZ), maxDistance), th)){
+                hit.distance = th;
+                hit.position = origin + d*th;
+                hit.normal   = getNormalAt(hit.position.x, hit.position.z);
+                return true;
             }
         }
+        // next tile
+        if(tX < tZ){ tIn = tX; tX += dtX; ix += stepX; }
+        else       { tIn = tZ; tZ += dtZ; iz += stepZ; }
     }
-    return m;
+    return false;
+}
+
+bool LodTerrain::heightBoundsIn(const glm::vec2& lo, const glm::vec2& hi,
+                                float& minHeight, float& maxHeight) const {
+    bool any = false;
+    minHeight = 1e30f; maxHeight = -1e30f;
+    for(int iz=tileCoord(lo.y); iz<=tileCoord(hi.y); ++iz){
+      for(int ix=tileCoord(lo.x); ix<=tileCoord(hi.x); ++ix){
+        auto it = _tiles.find(tileKey(ix, iz));
+        if(it == _tiles.end() || it->second.pyramid.empty()) continue;
+        const Tile& t = it->second;
+        float N = float(t.heightmap.gridSize()-1), toGrid = N/_scale;
+        auto cellOf=[&](float w, float o){ return std::min(std::max((w-o)*toGrid, 0.0f), N); };
+        float x0 = cellOf(lo.x, t.origin.x), x1 = cellOf(hi.x, t.origin.x);
+        float z0 = cellOf(lo.y, t.origin.z), z1 = cellOf(hi.y, t.origin.z);
+        glm::vec2 r = t.pyramid.rectRange(std::size_t(x0), std::size_t(z0),
+                                          std::max(std::size_t(std::ceil(x1)), std::size_t(x0)+1),
+                                          std::max(std::size_t(std::ceil(z1)), std::size_t(z0)+1));
+        minHeight = std::min(minHeight, r.x + t.origin.y);
+        maxHeight = std::max(maxHeight, r.y + t.origin.y);
+        any = true;
+      }
+    }
+    return any;
+}
+
+
+// vertices start morphing towards the parent at this fraction of its range
+static const float kMorphStart = 0.7f;
+
+static float distanceToBox(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi){
+    glm::vec3 d = glm::max(glm::max(lo-p, p-hi), glm::vec3(0.0f));
+    return glm::length(d);
 }
 
 // find smallest 2^k>=n
@@ -108,36 +238,32 @@ static std::size_t smallestPow2(std::size_t n){
     return p;
 }
 
-LodTerrain::LodTerrain(std::size_t tileSize,
+LodTerrain::LodTerrain(AssetLoader& assets,
+                       std::size_t tileSize,
                        int lodLevels,
                        float scale,
                        float heightScale,
                        float smoothness,
                        const std::string& a,
-                       const std::string& n)
+                       const std::string& n,
+                       std::uint32_t seed)
   : _lodLevels(lodLevels)
   , _tileSize(tileSize)
   , _scale(scale)
   , _heightScale(heightScale)
   , _smoothness(smoothness)
   , _yOffset(0.0f)
+  , _seed(seed)
 {
     initializeNoise();
-    initializeTextures(a,n);
+    initializeTextures(assets,a,n);
     initializeTiles();
 }
 
 LodTerrain::~LodTerrain(){
     // free GPU
-    for(auto& t:_tiles){
-        for(auto& L:t.lods){
-            glDeleteVertexArrays(1,&L.vao);
-            glDeleteBuffers(1,&L.vbo);
-            glDeleteBuffers(1,&L.ebo);
-        }
-    }
-    glDeleteTextures(1,&_albedo);
-    glDeleteTextures(1,&_normal);
+    for(auto& kv:_tiles) releaseTile(kv.second);
+    releaseGridIndices(_patchRes);
 }
 
 void LodTerrain::initializeNoise(){
@@ -145,135 +271,597 @@ void LodTerrain::initializeNoise(){
     _detailNoise.SetFrequency(0.2f);
 }
 
-void LodTerrain::loadTexture(const std::string& path, GLuint& texID){
-    int w,h,c;
-    unsigned char* data=stbi_load(path.c_str(),&w,&h,&c,0);
-    if(!data){ std::cerr<<"Failed to load "<<path<<"\n"; return; }
-    GLenum fmt=(c==3?GL_RGB:GL_RGBA);
-    glGenTextures(1,&texID);
-    glBindTexture(GL_TEXTURE_2D,texID);
-    glTexImage2D(GL_TEXTURE_2D,0,fmt,w,h,0,fmt,GL_UNSIGNED_BYTE,data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    stbi_image_free(data);
+void LodTerrain::initializeTextures(AssetLoader& assets, const std::string& a,const std::string& n){
+    _albedo = assets.texture(a);
+    _normal = assets.texture(n);
 }
 
-void LodTerrain::initializeTextures(const std::string& a,const std::string& n){
-    loadTexture(a,_albedo);
-    loadTexture(n,_normal);
+void LodTerrain::initializeTiles(){
+    std::size_t N = smallestPow2(_tileSize);
+
+    // every node is a patch of the same size; at least 2 quads so the
+    // parent surface always lands on even patch vertices
+    _lodLevels = std::max(_lodLevels, 1);
+    while(_lodLevels > 1 && (N >> (_lodLevels-1)) < 2) --_lodLevels;
+    _patchRes = N >> (_lodLevels-1);
+    _levelError.assign(_lodLevels, 0.0f);
+    _levelDiag.assign(_lodLevels, 0.0f);
+
+    // one index buffer for the (P+1)^2 patch, offset per node with baseVertex
+    _patch = acquireGridIndices(_patchRes);
+
+    // no tile is built here: the first update() queues them on the workers,
+    // so construction returns immediately and the first frame is not held up
 }
 
-void LodTerrain::initializeTiles(){
-    Tile base;
-    base.origin = glm::vec3(-_scale*0.5f, _yOffset, -_scale*0.5f);
+bool LodTerrain::hasHeightsAt(float worldX, float worldZ) const {
+    return _tiles.count(tileKey(tileCoord(worldX), tileCoord(worldZ))) != 0;
+}
+
+bool LodTerrain::heightsChangedIn(const glm::vec2& lo, const glm::vec2& hi, std::uint64_t version) const {
+    if(version == _heightsVersion) return false;
+    if(version < _changeHorizon) return true;   // history already dropped
+    int x0 = tileCoord(lo.x), x1 = tileCoord(hi.x);
+    int z0 = tileCoord(lo.y), z1 = tileCoord(hi.y);
+    // wide rectangles (low sun shadow footprints) walk the changes instead
+    if(std::int64_t(x1-x0+1)*(z1-z0+1) > std::int64_t(_tileVersions.size())){
+        for(auto const& kv:_tileVersions){
+            int ix = int(std::int32_t(kv.first >> 32)), iz = int(std::int32_t(kv.first));
+            if(kv.second > version && ix >= x0 && ix <= x1 && iz >= z0 && iz <= z1) return true;
+        }
+        return false;
+    }
+    for(int iz=z0; iz<=z1; ++iz){
+      for(int ix=x0; ix<=x1; ++ix){
+        auto it = _tileVersions.find(tileKey(ix, iz));
+        if(it != _tileVersions.end() && it->second > version) return true;
+      }
+    }
+    return false;
+}
+
+// nodes and their vertices are stored level by level, root first, row-major
+// inside a level. so any prefix of the vertex buffer holds whole coarse levels
+// and a tile can draw as soon as its first levels are uploaded.
+std::size_t LodTerrain::firstNodeOfLevel(int level) const {
+    int depth = _lodLevels-1 - level;
+    return ((std::size_t(1) << (2*depth)) - 1) / 3;   // 1 + 4 + ... + 4^(depth-1)
+}
+
+std::size_t LodTerrain::levelVertexEnd(int level) const {
+    int depth = _lodLevels-1 - level;
+    std::size_t V = _patchRes+1;
+    return (firstNodeOfLevel(level) + (std::size_t(1) << (2*depth))) * V*V;
+}
+
+std::uint64_t LodTerrain::tileKey(int ix, int iz){
+    return (std::uint64_t(std::uint32_t(ix)) << 32) | std::uint32_t(iz);
+}
+
+int LodTerrain::tileCoord(float world) const {
+    // tile 0 spans [-scale/2, scale/2)
+    return int(std::floor(world/_scale + 0.5f));
+}
+
+// the generator is seeded on global cells, so any tile's heights can be
+// rebuilt anywhere; neighbours share their border cells. single-threaded:
+// this runs on a worker, and tiles build side by side instead
+void LodTerrain::generateHeights(Heightfield& hf, int ix, int iz) const {
+    std::size_t N = hf.gridSize()-1;
+    generateDiamondSquare(hf,_smoothness,_seed,
+                          std::int32_t(ix*std::int64_t(N)), std::int32_t(iz*std::int64_t(N)), 1);
+    hf.scale(_heightScale);
+}
+
+namespace {
+// heightmaps kept for neighbouring builds: the tiles in flight and a ring
+// around them (64 KiB each at the default 128 tile size)
+const std::size_t kHeightCacheTiles = 64;
+}
+
+std::shared_ptr<const Heightfield> LodTerrain::generatedHeights(int ix, int iz) const {
+    std::uint64_t key = tileKey(ix, iz);
+    std::promise<std::shared_ptr<const Heightfield>> made;
+    HeightCache::Heights heights;
+    bool generate = false;
+    {
+        std::lock_guard<std::mutex> lock(_heightCache.mutex);
+        auto it = _heightCache.entries.find(key);
+        if(it != _heightCache.entries.end()){
+            _heightCache.order.splice(_heightCache.order.begin(), _heightCache.order, it->second.use);
+            heights = it->second.heights;
+        } else {
+            heights = made.get_future().share();
+            generate = true;
+            _heightCache.order.push_front(key);
+            _heightCache.entries.emplace(key, HeightCache::Entry{heights, _heightCache.order.begin()});
+            if(_heightCache.entries.size() > kHeightCacheTiles){
+                _heightCache.entries.erase(_heightCache.order.back());
+                _heightCache.order.pop_back();
+            }
+        }
+    }
+    if(generate){
+        try {
+            auto hf = std::make_shared<Heightfield>(smallestPow2(_tileSize)+1);
+            generateHeights(*hf, ix, iz);
+            made.set_value(std::move(hf));
+        } catch(...) {
+            made.set_exception(std::current_exception());
+        }
+    }
+    return heights.get();
+}
+
+LodTerrain::BorderedHeights LodTerrain::borderedHeights(const Tile& tile) const {
+    const Heightfield& H = tile.heightmap;
+    long G = long(H.gridSize()), N = G-1;
+    BorderedHeights B;
+    B.size = G;
+    B.ring = long(1) << (_lodLevels-1);   // the root's sample spacing
+    long W = G + 2*B.ring;
+    B.h.assign(std::size_t(W*W), 0.0f);
+    auto put=[&](long x, long z, float h){ B.h[std::size_t((z+B.ring)*W + x+B.ring)] = h; };
+    for(long z=0;z<G;++z)
+        for(long x=0;x<G;++x) put(x, z, H.at(x,z));
+
+    // each edge neighbour's heights (shared with its own build) give the
+    // strip along our edge
+    const int dx[4] = {-1, 1, 0, 0}, dz[4] = {0, 0, -1, 1};
+    for(int k=0;k<4;++k){
+        std::shared_ptr<const Heightfield> neighbour = generatedHeights(tile.ix+dx[k], tile.iz+dz[k]);
+        const Heightfield& n = *neighbour;
+        for(long j=0;j<G;++j){
+          for(long r=1;r<=B.ring;++r){
+            long out = (dx[k]+dz[k]) < 0 ? -r : N+r;   // past our edge
+            long in  = (dx[k]+dz[k]) < 0 ? N-r : r;    // the same cell in n
+            if(dx[k]) put(out, j, n.at(in, j));
+            else      put(j, out, n.at(j, in));
+          }
+        }
+    }
+    return B;
+}
+
+std::unique_ptr<LodTerrain::Tile> LodTerrain::buildTile(int ix, int iz) const {
+    if(auto cached = loadCachedTile(ix, iz)) return cached;
+
+    auto tile = std::make_unique<Tile>();
+    tile->ix = ix; tile->iz = iz;
+    tile->origin = glm::vec3((ix-0.5f)*_scale, _yOffset, (iz-0.5f)*_scale);
+
+    tile->heightmap = *generatedHeights(ix, iz);
+
+    auto mm = std::minmax_element(tile->heightmap.data(), tile->heightmap.data()+tile->heightmap.storageSize());
+    tile->heights.min    = _yOffset + *mm.first;
+    tile->heights.extent = std::max(*mm.second - *mm.first, 1e-3f);
+    BorderedHeights B = borderedHeights(*tile);
+    buildNormalGrid(*tile, B);
+    tile->pyramid = HeightPyramid(tile->heightmap);
+
+    // every node of every level; each writes its own vertex slots. this is
+    // one ThreadPool job, so it stays on its worker: the parallelism comes
+    // from update() keeping several tiles in flight
+    std::size_t nodeCount = firstNodeOfLevel(-1);
+    std::size_t V = _patchRes+1;
+    tile->nodes.resize(nodeCount);
+    tile->staging.resize(nodeCount*V*V);
+    for(int level=_lodLevels-1; level>=0; --level){
+        std::size_t first = firstNodeOfLevel(level);
+        std::size_t dim = std::size_t(1) << (_lodLevels-1 - level);
+        std::size_t span = (_patchRes << level);
+        for(std::size_t k=first; k<first+dim*dim; ++k){
+            std::size_t nx = (k-first) % dim, nz = (k-first) / dim;
+            buildNode(*tile, B, int(k), level, nx*span, nz*span);
+        }
+    }
+
+    // errors bottom-up: full res is within child.error of the child, and the
+    // child is within its morph distance of us
+    for(int level=1; level<_lodLevels; ++level){
+        std::size_t first = firstNodeOfLevel(level);
+        std::size_t dim = std::size_t(1) << (_lodLevels-1 - level);
+        for(std::size_t k=first; k<first+dim*dim; ++k){
+            Node& n = tile->nodes[k];
+            for(int c:n.child){
+                Node const& cn = tile->nodes[c];
+                n.error = std::max(n.error, cn.error + cn.morphDev);
+            }
+        }
+    }
+    tile->vertexCount = tile->staging.size();
+    saveCachedTile(*tile);
+    return tile;
+}
+
+namespace {
+// bump kCacheVersion whenever the generator, Node or TerrainVertex change
+const char*         kCacheDir     = "cache/terrain";
+const std::uint32_t kCacheVersion = 5;
+
+// file = header, heights, normal x, normal z (gridSize^2 floats each),
+// nodes, packed vertices
+struct TileCacheHeader {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint32_t nodeSize, vertexSize;
+    // build parameters; all must match
+    std::uint64_t tileSize;
+    std::int32_t  lodLevels;
+    float         scale, heightScale, smoothness, yOffset;
+    std::uint32_t seed;
+    std::int32_t  ix, iz;
+    // payload
+    std::uint64_t gridSize, nodeCount, vertexCount;
+    float         heightMin, heightExtent;
+};
+}
+
+std::string LodTerrain::cachePath(int ix, int iz) const {
+    // FNV-1a over the parameters only, so one directory serves many worlds
+    std::uint64_t h = 1469598103934665603ull;
+    auto mix=[&h](const void* p, std::size_t n){
+        auto b = static_cast<const unsigned char*>(p);
+        for(std::size_t i=0;i<n;++i){ h ^= b[i]; h *= 1099511628211ull; }
+    };
+    std::uint64_t ts = _tileSize;
+    mix(&kCacheVersion,sizeof kCacheVersion); mix(&ts,sizeof ts); mix(&_lodLevels,sizeof _lodLevels);
+    mix(&_scale,sizeof _scale); mix(&_heightScale,sizeof _heightScale);
+    mix(&_smoothness,sizeof _smoothness); mix(&_yOffset,sizeof _yOffset); mix(&_seed,sizeof _seed);
+
+    char name[96];
+    std::snprintf(name, sizeof name, "/%016llx_%d_%d.tile", (unsigned long long)h, ix, iz);
+    return kCacheDir + std::string(name);
+}
+
+std::unique_ptr<LodTerrain::Tile> LodTerrain::loadCachedTile(int ix, int iz) const {
+    auto file = std::make_unique<MappedFile>(cachePath(ix, iz));
+    if(!file->valid() || file->size() < sizeof(TileCacheHeader)) return nullptr;
+
+    TileCacheHeader hdr;
+    std::memcpy(&hdr, file->data(), sizeof hdr);
     std::size_t N = smallestPow2(_tileSize);
-    base.gridSize = N+1;
-
-    auto raw = generateTerrain(N,_smoothness);
-    base.heightmap.resize((N+1)*(N+1));
-    for(std::size_t z=0;z<=N;++z)
-      for(std::size_t x=0;x<=N;++x)
-        base.heightmap[z*(N+1)+x] = raw[z][x]*_heightScale;
-
-    _tiles.push_back(std::move(base));
-    generateLODs(_tiles[0]);
-}
-
-void LodTerrain::generateLODs(Tile& tile){
-    // we only have one tile, generate each LOD
-    for(int lvl=0;lvl<_lodLevels;++lvl){
-        std::size_t res = std::max<std::size_t>(_tileSize>>lvl,2u);
-        TileLOD lod{};
-        buildTileMesh(tile,lod,res);
-        // center for LOD distance check:
-        lod.center = tile.origin + glm::vec3(_scale*0.5f,0,_scale*0.5f);
-        tile.lods.push_back(lod);
+    bool match = std::memcmp(hdr.magic,"LTC1",4)==0 && hdr.version==kCacheVersion
+              && hdr.nodeSize==sizeof(Node) && hdr.vertexSize==sizeof(TerrainVertex)
+              && hdr.tileSize==_tileSize && hdr.lodLevels==_lodLevels
+              && hdr.scale==_scale && hdr.heightScale==_heightScale
+              && hdr.smoothness==_smoothness && hdr.yOffset==_yOffset && hdr.seed==_seed
+              && hdr.ix==ix && hdr.iz==iz && hdr.gridSize==N+1;
+    if(!match) return nullptr;
+
+    std::size_t heightBytes = hdr.gridSize*hdr.gridSize*sizeof(float);
+    std::size_t nodeBytes   = hdr.nodeCount*sizeof(Node);
+    std::size_t vertexBytes = hdr.vertexCount*sizeof(TerrainVertex);
+    if(file->size() != sizeof hdr + 3*heightBytes + nodeBytes + vertexBytes) return nullptr;
+
+    auto tile = std::make_unique<Tile>();
+    tile->ix = ix; tile->iz = iz;
+    tile->origin = glm::vec3((ix-0.5f)*_scale, _yOffset, (iz-0.5f)*_scale);
+    tile->heights.min = hdr.heightMin;
+    tile->heights.extent = hdr.heightExtent;
+
+    // heights and nodes are small and live on the CPU: copy them out.
+    // vertices are only read by the GL upload, straight from the mapping
+    const unsigned char* p = file->data() + sizeof hdr;
+    tile->heightmap = Heightfield(hdr.gridSize);
+    std::memcpy(tile->heightmap.data(), p, heightBytes);   p += heightBytes;
+    tile->normalX.assign(reinterpret_cast<const float*>(p), reinterpret_cast<const float*>(p+heightBytes)); p += heightBytes;
+    tile->normalZ.assign(reinterpret_cast<const float*>(p), reinterpret_cast<const float*>(p+heightBytes)); p += heightBytes;
+    tile->nodes.resize(hdr.nodeCount);
+    std::memcpy(tile->nodes.data(), p, nodeBytes);         p += nodeBytes;
+    tile->pyramid = HeightPyramid(tile->heightmap);        // cheaper to rebuild than to read
+
+    tile->cachedOffset = std::size_t(p - file->data());
+    tile->vertexCount  = hdr.vertexCount;
+    file->prefetch(tile->cachedOffset, vertexBytes);
+    tile->cached = std::move(file);
+    return tile;
+}
+
+void LodTerrain::saveCachedTile(const Tile& tile) const {
+    static_assert(std::is_trivially_copyable<Node>::value, "Node is written raw");
+
+    TileCacheHeader hdr{};
+    std::memcpy(hdr.magic,"LTC1",4);
+    hdr.version = kCacheVersion;
+    hdr.nodeSize = sizeof(Node); hdr.vertexSize = sizeof(TerrainVertex);
+    hdr.tileSize = _tileSize; hdr.lodLevels = _lodLevels;
+    hdr.scale = _scale; hdr.heightScale = _heightScale;
+    hdr.smoothness = _smoothness; hdr.yOffset = _yOffset; hdr.seed = _seed;
+    hdr.ix = tile.ix; hdr.iz = tile.iz;
+    hdr.gridSize = tile.heightmap.gridSize();
+    hdr.nodeCount = tile.nodes.size(); hdr.vertexCount = tile.vertexCount;
+    hdr.heightMin = tile.heights.min; hdr.heightExtent = tile.heights.extent;
+
+    // write to a temp name and rename, so a reader never maps a partial file
+    std::error_code ec;
+    std::filesystem::create_directories(kCacheDir, ec);
+    std::string path = cachePath(tile.ix, tile.iz);
+    std::string tmp  = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof hdr);
+        out.write(reinterpret_cast<const char*>(tile.heightmap.data()), hdr.gridSize*hdr.gridSize*sizeof(float));
+        out.write(reinterpret_cast<const char*>(tile.normalX.data()), tile.normalX.size()*sizeof(float));
+        out.write(reinterpret_cast<const char*>(tile.normalZ.data()), tile.normalZ.size()*sizeof(float));
+        out.write(reinterpret_cast<const char*>(tile.nodes.data()), tile.nodes.size()*sizeof(Node));
+        out.write(reinterpret_cast<const char*>(tile.vertexData()), tile.vertexCount*sizeof(TerrainVertex));
+        if(!out){
+            std::cerr<<"Failed to write terrain cache "<<tmp<<"\n";
+            out.close();
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
     }
+    std::filesystem::rename(tmp, path, ec);
+    if(ec) std::cerr<<"Failed to write terrain cache "<<path<<": "<<ec.message()<<"\n";
 }
 
-void LodTerrain::buildTileMesh(Tile& tile, TileLOD& lod, std::size_t res){
-    // gather positions, uvs, normals
-    std::size_t N2 = tile.gridSize-1;
-    float step = _scale/float(res-1);
-
-    struct V{ glm::vec3 p; glm::vec2 uv; glm::vec3 n; };
-    std::vector<V> verts; verts.reserve(res*res);
-
-    for(std::size_t z=0;z<res;++z){
-      for(std::size_t x=0;x<res;++x){
-        float u=float(x)/(res-1), v=float(z)/(res-1);
-        std::size_t i=std::min<std::size_t>(std::round(u*N2),N2),
-                     j=std::min<std::size_t>(std::round(v*N2),N2);
-        glm::vec3 P = tile.origin +
-            glm::vec3(x*step,
-                      tile.heightmap[j*(N2+1)+i],
-                      z*step);
-        verts.push_back({P, {u,u}, {0,1,0}}); // normal will fix below
-      }
+void LodTerrain::beginUpload(Tile& tile){
+    // per-level error and size bounds feed the LOD ranges
+    for(auto const& n:tile.nodes){
+        _levelError[n.level] = std::max(_levelError[n.level], n.error);
+        _levelDiag[n.level]  = std::max(_levelDiag[n.level], glm::length(n.aabbMax-n.aabbMin));
     }
 
-    // compute normals via finite‐difference
-    auto idx=[&](int x,int z){ return z*res + x; };
-    for(int z=0;z<res;++z){
-      for(int x=0;x<res;++x){
-        float hl=verts[idx(std::max(x-1,0),z)].p.y;
-        float hr=verts[idx(std::min(int(x+1),int(res-1)),z)].p.y;
-        float hd=verts[idx(x,std::max(z-1,0))].p.y;
-        float hu=verts[idx(x,std::min(int(z+1),int(res-1)))].p.y;
-        glm::vec3 tan{2*step, hr-hl,0}, bit{0,hu-hd,2*step};
-        verts[idx(x,z)].n = glm::normalize(glm::cross(tan,bit));
+    // allocate only; the data follows in slices, coarsest level first
+    tile.readyLevel = _lodLevels;
+    glGenVertexArrays(1,&tile.vao);
+    glGenBuffers(1,&tile.vbo);
+
+    glBindVertexArray(tile.vao);
+      glBindBuffer(GL_ARRAY_BUFFER,tile.vbo);
+      glBufferData(GL_ARRAY_BUFFER,tile.vertexCount*sizeof(TerrainVertex),nullptr,GL_STATIC_DRAW);
+      setupTerrainVertexAttribs();
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_patch.ebo);
+    glBindVertexArray(0);
+}
+
+std::size_t LodTerrain::uploadSlice(Tile& tile, std::size_t maxBytes){
+    std::size_t total = tile.vertexCount*sizeof(TerrainVertex);
+    std::size_t bytes = std::min(maxBytes, total - tile.uploaded);
+
+    glBindBuffer(GL_ARRAY_BUFFER,tile.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER,tile.uploaded,bytes,
+                    reinterpret_cast<const char*>(tile.vertexData()) + tile.uploaded);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    tile.uploaded += bytes;
+
+    // coarse levels sit first: draw as soon as the root level is in
+    while(tile.readyLevel > 0 &&
+          tile.uploaded >= levelVertexEnd(tile.readyLevel-1)*sizeof(TerrainVertex))
+        --tile.readyLevel;
+    tile.resident = tile.readyLevel < _lodLevels;
+
+    if(tile.uploaded == total){
+        std::vector<TerrainVertex>().swap(tile.staging);
+        tile.cached.reset();
+    }
+    return bytes;
+}
+
+void LodTerrain::releaseTile(Tile& tile){
+    glDeleteVertexArrays(1,&tile.vao);
+    glDeleteBuffers(1,&tile.vbo);
+    tile.vao = tile.vbo = 0;
+    tile.resident = false;
+}
+
+void LodTerrain::update(const glm::vec3& camPos){
+    int cx = tileCoord(camPos.x), cz = tileCoord(camPos.z);
+    int keep = _viewRadius + 1;   // one ring of slack against thrashing
+    auto inRange=[&](int ix, int iz, int r){
+        return std::abs(ix-cx) <= r && std::abs(iz-cz) <= r;
+    };
+
+    // direction of travel, smoothed so a single jittery frame does not count
+    glm::vec2 step(camPos.x-_lastCamPos.x, camPos.z-_lastCamPos.z);
+    _lastCamPos = camPos;
+    if(glm::length(step) > 1e-3f)
+        _travelDir = glm::mix(_travelDir, glm::normalize(step), 0.25f);
+
+    // 1) take finished builds (never blocks)
+    for(auto it=_pending.begin(); it!=_pending.end();){
+        if(it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready){ ++it; continue; }
+        std::unique_ptr<Tile> built = it->second.get();
+        if(inRange(built->ix, built->iz, keep)){
+            Tile& t = _tiles.emplace(it->first, std::move(*built)).first->second;
+            beginUpload(t);
+            _uploadQueue.push_back(it->first);
+            _tileVersions[it->first] = ++_heightsVersion;
+        }
+        it = _pending.erase(it);
+    }
+
+    // 2) upload under the per-frame budget, oldest tile first
+    std::size_t budget = _uploadBudget ? _uploadBudget : ~std::size_t(0);
+    while(budget > 0 && !_uploadQueue.empty()){
+        auto t = _tiles.find(_uploadQueue.front());
+        if(t == _tiles.end() || t->second.uploadDone()){ _uploadQueue.pop_front(); continue; }
+        budget -= uploadSlice(t->second, budget);
+        if(t->second.uploadDone()) _uploadQueue.pop_front();
+    }
+
+    // 3) evict what fell out of range
+    for(auto it=_tiles.begin(); it!=_tiles.end();){
+        if(inRange(it->second.ix, it->second.iz, keep)){ ++it; continue; }
+        releaseTile(it->second);
+        _tileVersions[it->first] = ++_heightsVersion;
+        it = _tiles.erase(it);
+    }
+
+    // 4) queue missing tiles: the view square by distance, then the ring
+    //    beyond it that lies ahead of the camera
+    struct Want { float priority; int ix, iz; };
+    std::vector<Want> wants;
+    for(int dz=-keep; dz<=keep; ++dz){
+      for(int dx=-keep; dx<=keep; ++dx){
+        float d = std::sqrt(float(dx*dx + dz*dz));
+        if(std::max(std::abs(dx),std::abs(dz)) <= _viewRadius){
+            wants.push_back({d, cx+dx, cz+dz});
+        } else if(glm::length(_travelDir) > 0.5f &&
+                  glm::dot(glm::vec2(dx,dz)/d, glm::normalize(_travelDir)) > 0.7f){
+            wants.push_back({d + float(keep), cx+dx, cz+dz});
+        }
       }
     }
+    std::sort(wants.begin(), wants.end(),
+              [](const Want& a, const Want& b){ return a.priority < b.priority; });
+
+    // keep the queue short so it follows the camera instead of lagging
+    std::size_t maxInFlight = 2*_workers.size();
+    for(auto const& w:wants){
+        if(_pending.size() >= maxInFlight) break;
+        std::uint64_t key = tileKey(w.ix, w.iz);
+        if(_tiles.count(key) || _pending.count(key)) continue;
+        int ix = w.ix, iz = w.iz;
+        _pending.emplace(key, _workers.submit([this,ix,iz]{ return buildTile(ix,iz); }));
+    }
 
-    // build index array
-    std::vector<GLuint> idxs; idxs.reserve((res-1)*(res-1)*6);
-    for(std::size_t z=0;z+1<res;++z){
-      for(std::size_t x=0;x+1<res;++x){
-        GLuint tl=z*res+x, tr=tl+1, bl=tl+res, br=bl+1;
-        idxs.insert(idxs.end(),{tl,bl,tr,tr,bl,br});
+    // 5) forget changes older than the history window
+    _versionHistory.push_back(_heightsVersion);
+    if(_versionHistory.size() > std::size_t(kChangeHistory)){
+        _versionHistory.pop_front();
+        if(_versionHistory.front() != _changeHorizon){
+            _changeHorizon = _versionHistory.front();
+            for(auto it=_tileVersions.begin(); it!=_tileVersions.end();)
+                it = it->second <= _changeHorizon ? _tileVersions.erase(it) : std::next(it);
+        }
+    }
+}
+
+void LodTerrain::buildNode(Tile& tile, const BorderedHeights& B, int index, int level,
+                           std::size_t x0, std::size_t z0) const {
+    const Heightfield& H = tile.heightmap;
+    std::size_t N = H.gridSize()-1;
+    std::size_t s = std::size_t(1) << level;   // grid cells per patch quad
+    float cell = _scale/float(N);
+    bool hasParent = level+1 < _lodLevels;
+    std::size_t V = _patchRes+1;
+
+    Node& node = tile.nodes[index];
+    node.level = level;
+    node.baseVertex = GLint(std::size_t(index)*V*V);
+    TerrainVertex* out = tile.staging.data() + node.baseVertex;
+
+    // central-difference normal at this level's spacing, across tile seams too
+    auto normalAt=[&](std::size_t X, std::size_t Z){
+        long x = long(X), z = long(Z), d = long(s);
+        glm::vec3 tan{2.0f*float(d)*cell, B.at(x+d,z)-B.at(x-d,z), 0};
+        glm::vec3 bit{0, B.at(x,z+d)-B.at(x,z-d), 2.0f*float(d)*cell};
+        return glm::normalize(glm::cross(bit,tan));
+    };
+
+    float maxDev = 0.0f;
+    for(std::size_t j=0;j<=_patchRes;++j){
+      for(std::size_t i=0;i<=_patchRes;++i){
+        std::size_t X = x0 + i*s, Z = z0 + j*s;
+        glm::vec3 p = tile.origin + glm::vec3(X*cell, H.at(X,Z), Z*cell);
+        glm::vec3 n = normalAt(X,Z);
+        float morphY = p.y; glm::vec3 morphN = n;
+
+        // odd vertices vanish in the parent: take the parent's edge/diagonal
+        bool oi = i&1, oj = j&1;
+        if(hasParent && (oi || oj)){
+            std::size_t ax,az,bx,bz;
+            if(oi && !oj)      { ax=X-s; az=Z;   bx=X+s; bz=Z;   }
+            else if(!oi && oj) { ax=X;   az=Z-s; bx=X;   bz=Z+s; }
+            else               { ax=X+s; az=Z-s; bx=X-s; bz=Z+s; } // tr–bl diagonal
+            morphY = tile.origin.y + 0.5f*(H.at(ax,az)+H.at(bx,bz));
+            morphN = glm::normalize(normalAt(ax,az)+normalAt(bx,bz));
+        }
+        maxDev = std::max(maxDev, std::abs(p.y - morphY));
+        *out++ = packTerrainVertex(tile.heights, p.y, n, morphY, morphN);
       }
     }
-    lod.indexCount = idxs.size();
-
-    // upload to GL
-    glGenVertexArrays(1,&lod.vao);
-    glGenBuffers(1,&lod.vbo);
-    glGenBuffers(1,&lod.ebo);
-
-    glBindVertexArray(lod.vao);
-      glBindBuffer(GL_ARRAY_BUFFER,lod.vbo);
-      glBufferData(GL_ARRAY_BUFFER,verts.size()*sizeof(V),verts.data(),GL_STATIC_DRAW);
-
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(V),(void*)0);
-      glEnableVertexAttribArray(1);
-      glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,sizeof(V),(void*)offsetof(V,uv));
-      glEnableVertexAttribArray(2);
-      glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,sizeof(V),(void*)offsetof(V,n));
-
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,lod.ebo);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER,idxs.size()*sizeof(GLuint),idxs.data(),GL_STATIC_DRAW);
-    glBindVertexArray(0);
+    // bounds from the min/max pyramid: they hold the full-res surface, so
+    // also every vertex and morph target of this node
+    std::size_t span = _patchRes*s;
+    glm::vec2 range = tile.pyramid.blockRange(x0, z0, span);
+    node.aabbMin = tile.origin + glm::vec3(x0*cell, range.x, z0*cell);
+    node.aabbMax = tile.origin + glm::vec3((x0+span)*cell, range.y, (z0+span)*cell);
+    node.morphDev = maxDev;
+
+    if(level > 0){
+        std::size_t first = firstNodeOfLevel(level-1);
+        std::size_t dim = std::size_t(1) << (_lodLevels - level);
+        std::size_t childSpan = _patchRes << (level-1);
+        std::size_t nx = x0/childSpan, nz = z0/childSpan;
+        for(int c=0;c<4;++c)
+            node.child[c] = int(first + (nz + (c>>1))*dim + nx + (c&1));
+    }
 }
 
-void LodTerrain::Draw(const glm::vec3& camPos){
+void LodTerrain::updateLodRanges(float fovY, float viewportHeight){
+    // a node of error e at distance d covers e*K/d pixels on screen
+    float K = viewportHeight / (2.0f*std::tan(0.5f*fovY));
+    _lodRange.assign(_lodLevels, 0.0f);
+    for(int l=1;l<_lodLevels;++l){
+        float r = _levelError[l]*K/_pixelError;
+        r = std::max(r, 2.0f*_lodRange[l-1]);
+        r = std::max(r, _levelDiag[l-1]);
+        // nodes of level l-2 sit within range[l-1]+diag[l-1]; their level l-1
+        // neighbours must not have started morphing there or the seam cracks
+        if(l >= 2) r = std::max(r, (_lodRange[l-1] + _levelDiag[l-1]) / kMorphStart);
+        _lodRange[l] = r;
+    }
+}
+
+void LodTerrain::Draw(const Shader& shader,
+                      const glm::vec3& camPos,
+                      const glm::mat4& viewProj,
+                      float fovY,
+                      float viewportHeight){
     // bind textures to unit 0/1
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D,_albedo);
+    glBindTexture(GL_TEXTURE_2D,_albedo.id());
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D,_normal);
-
-    // choose LOD by distance
-    static const float dists[] = {50,100,200,400};
-    float dist = glm::distance(camPos,_tiles[0].lods[0].center);
-    int  lod  = 0;
-    while(lod+1<_lodLevels && dist>dists[lod]) ++lod;
+    glBindTexture(GL_TEXTURE_2D,_normal.id());
+
+    updateLodRanges(fovY, viewportHeight);
+    Frustum frustum(viewProj);
+
+    shader.setVec3("lodCameraPos", camPos);
+    GLint locRange = shader.location("morphRange");
+    GLint locPatch = shader.location("patchInfo");
+    GLint locXform = shader.location("nodeXform");
+    GLint locHeights = shader.location("heightRange");
+    GLint patchVerts = GLint(_patchRes+1);
+    float cell = _scale/float(smallestPow2(_tileSize));
+    _lastTriangles = 0;
+
+    std::vector<int> stack;
+    stack.reserve(4*_lodLevels);
+    for(auto const& kv:_tiles){
+        const Tile& tile = kv.second;
+        if(!tile.resident) continue;
+        glBindVertexArray(tile.vao);
+        glUniform2f(locHeights, tile.heights.min, tile.heights.extent);
+        stack.assign(1, 0);
+        while(!stack.empty()){
+            Node const& n = tile.nodes[stack.back()];
+            stack.pop_back();
+            if(!frustum.intersects(n.aabbMin, n.aabbMax)) continue;
+
+            // too coarse this close: let the children decide, once their
+            // level has been uploaded
+            if(n.level > 0 && n.level-1 >= tile.readyLevel &&
+               distanceToBox(camPos, n.aabbMin, n.aabbMax) < _lodRange[n.level]){
+                for(int c:n.child) stack.push_back(c);
+                continue;
+            }
 
-    TileLOD const& L = _tiles[0].lods[lod];
-    glBindVertexArray(L.vao);
-    glDrawElements(GL_TRIANGLES,L.indexCount,GL_UNSIGNED_INT,nullptr);
+            int parent = n.level+1;
+            if(parent < _lodLevels)
+                glUniform2f(locRange, kMorphStart*_lodRange[parent], _lodRange[parent]);
+            else
+                glUniform2f(locRange, 1e30f, 2e30f);  // root: nothing to morph into
+            glUniform2i(locPatch, patchVerts, n.baseVertex);
+            glUniform3f(locXform, n.aabbMin.x, n.aabbMin.z, cell*float(1 << n.level));
+            glDrawElementsBaseVertex(GL_TRIANGLES,_patch.count,_patch.type,nullptr,n.baseVertex);
+            _lastTriangles += _patch.count/3;
+        }
+    }
     glBindVertexArray(0);
 }
@@ -3,69 +3,258 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include "../lib/glad.h"
 #include "../lib/FastNoiseLite.h"
+#include "heightfield.h"
+#include "terrainVertex.h"
+#include "gridIndices.h"
+#include "heightPyramid.h"
+#include "../ultis/shaderReader.h"
+#include "../ultis/threadPool.h"
+#include "../ultis/assetLoader.h"
+#include "../ultis/mappedFile.h"
+
+struct TerrainHit {
+    glm::vec3 position;
+    glm::vec3 normal;
+    float     distance;   // along the normalized ray direction
+};
 
 class LodTerrain {
 public:
     // tileSize: base heightmap resolution (power of two)
-    // lodLevels: number of LOD levels to generate
-    // scale: world‐space width/depth of the terrain tile
+    // lodLevels: depth of the quadtree; leaves are tileSize>>(lodLevels-1)
+    //            quads wide and every node draws the same patch size
+    // scale: world‐space width/depth of one tile; tile (0,0) is centred on
+    //        the origin and the grid extends without bound in x and z
     // heightScale: vertical exaggeration
     // smoothness: diamond–square parameter
-    LodTerrain(std::size_t tileSize,
+    // seed: diamond–square seed, same seed => same heightmap
+    // the textures come through assets and show up with its next uploads
+    LodTerrain(AssetLoader& assets,
+               std::size_t tileSize,
                int          lodLevels,
                float        scale,
                float        heightScale,
                float        smoothness,
                const std::string& albedoPath,
-               const std::string& normalPath);
+               const std::string& normalPath,
+               std::uint32_t      seed = 1337);
     ~LodTerrain();
 
-    // Draws whichever LOD is appropriate for camPos
-    // Assumes you've already bound and set your terrain shader
-    // and updated its uniforms (model/view/proj, fog, light, etc.)
-    void Draw(const glm::vec3& camPos);
+    // Streams tiles around camPos. Call once per frame on the GL thread,
+    // before any Draw: takes finished worker builds, uploads at most the
+    // per-frame budget, drops tiles that fell out of range and queues new
+    // builds nearest first, then one ring further along the direction of travel.
+    // Nothing is built in the constructor; a tile draws its coarse levels
+    // as soon as they are uploaded and refines as the rest arrives.
+    void update(const glm::vec3& camPos);
+    // true once the tile under (worldX, worldZ) has been built, i.e.
+    // getHeightAt/getNormalAt return real terrain there
+    bool hasHeightsAt(float worldX, float worldZ) const;
+    // bumped whenever a tile's heights appear or go away, i.e. whenever
+    // getHeightAt may answer differently; lets callers cache what they derive
+    std::uint64_t heightsVersion() const { return _heightsVersion; }
+    // whether heights in the world-space xz rectangle [lo, hi] appeared or
+    // went away after `version` (a heightsVersion() value), so a cache over
+    // one region survives tiles streaming elsewhere. only the last
+    // kChangeHistory update()s are remembered: an older version answers true,
+    // so a caller that keeps asking should move its version forward
+    static constexpr int kChangeHistory = 64;
+    bool heightsChangedIn(const glm::vec2& lo, const glm::vec2& hi, std::uint64_t version) const;
+
+    // Walks the quadtree: nodes outside the frustum of viewProj are culled,
+    // the rest are refined until their screen-space error from camPos is
+    // below the pixel error. Assumes shader is bound with its other uniforms
+    // (model/view/proj, fog, light, etc.) already set; Draw sets the morph
+    // uniforms (lodCameraPos, morphRange) itself.
+    // fovY in radians, viewportHeight in pixels.
+    void Draw(const Shader& shader,
+              const glm::vec3& camPos,
+              const glm::mat4& viewProj,
+              float fovY,
+              float viewportHeight);
+
+    // max allowed screen-space error in pixels (default 2)
+    void setPixelError(float px) { _pixelError = px; }
+    // triangles submitted by the last Draw
+    std::size_t lastTriangleCount() const { return _lastTriangles; }
+
+    // tiles kept drawable around the camera tile, in tiles (default 1 -> 3x3)
+    void setViewRadius(int tiles) { _viewRadius = std::max(tiles, 0); }
+    // vertex bytes uploaded per update() (default 4 MiB); 0 = unlimited
+    void setUploadBudget(std::size_t bytes) { _uploadBudget = bytes; }
+    // tiles with a heightmap in memory / builds still on the workers
+    std::size_t tileCount()    const { return _tiles.size(); }
+    std::size_t pendingCount() const { return _pending.size(); }
+
 
     // exposes the two loaded textures:
-    GLuint albedoTex() const { return _albedo; }
-    GLuint normalTex() const { return _normal; }
+    GLuint albedoTex() const { return _albedo.id(); }
+    GLuint normalTex() const { return _normal.id(); }
+    // route to the tile under (worldX, worldZ); outside the streamed area
+    // the ground is flat at the base level
     float getHeightAt(float worldX, float worldZ) const;
     glm::vec3 getNormalAt(float worldX, float worldZ) const;
+    // batched form: heights[i] (and normals[i] if given) for xz[i] = (x, z).
+    // points are grouped by tile as they come, so keep nearby points together;
+    // normals are interpolated from a precomputed full-resolution grid
+    void getHeightsAt(const glm::vec2* xz, std::size_t count,
+                      float* heights, glm::vec3* normals = nullptr) const;
+
+    // First intersection of the ray with the loaded terrain within maxDistance
+    // (picking, line of sight, camera collision). Walks the tiles the ray
+    // crosses, then each tile's min/max pyramid down to the hit cell.
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir,
+                 TerrainHit& hit, float maxDistance = 1e4f) const;
+    // Conservative min/max terrain height over the world-space xz rectangle
+    // [lo, hi], from the pyramids of the loaded tiles (culling volumes,
+    // shadow frustum fitting). false if no loaded tile overlaps it.
+    bool heightBoundsIn(const glm::vec2& lo, const glm::vec2& hi,
+                        float& minHeight, float& maxHeight) const;
 
 private:
-    struct TileLOD {
-        GLuint vao=0, vbo=0, ebo=0;
-        GLsizei indexCount=0;
-        glm::vec3 center;
+    // one quadtree node: a (P+1)^2 patch sampled every 2^level cells,
+    // starting at aabbMin.xz. each vertex also carries the parent level's
+    // surface at its xz so the vertex shader can morph into it before the
+    // node is merged.
+    struct Node {
+        glm::vec3 aabbMin, aabbMax;   // world space, heights from the pyramid
+        float     error = 0.0f;       // max height deviation from full res
+        float     morphDev = 0.0f;    // max vertex travel while morphing
+        GLint     baseVertex = 0;     // first vertex inside Tile::vbo
+        int       level = 0;          // 0 = leaf (full resolution)
+        int       child[4] = {-1,-1,-1,-1};
     };
 
+    // built on a worker, then uploaded on the GL thread in budget-sized slices
     struct Tile {
-        glm::vec3      origin;
-        std::vector<TileLOD> lods;
-        std::vector<float>   heightmap; // size (N+1)*(N+1)
-        std::size_t          gridSize;  // =N+1
+        int                ix=0, iz=0;
+        glm::vec3          origin;
+        Heightfield        heightmap; // (N+1)^2, already scaled by heightScale
+        std::vector<float> normalX, normalZ; // full-res normal grid, y = sqrt(1-x²-z²)
+        HeightPyramid      pyramid;   // min/max over heightmap cells
+        TerrainHeightRange heights;   // quantization range of the packed heights
+        std::vector<Node>  nodes;     // nodes[0] is the root
+        // vertices come from a fresh build (staging) or straight from the
+        // mapped cache file; both are dropped once fully in vbo
+        std::vector<TerrainVertex>  staging;
+        std::unique_ptr<MappedFile> cached;
+        std::size_t        vertexCount=0, cachedOffset=0;
+        std::size_t        uploaded=0;// bytes already in vbo
+        GLuint             vao=0, vbo=0;
+        int                readyLevel=0;   // finest level fully in vbo (lodLevels: none)
+        bool               resident=false; // drawable (root level is in)
+
+        bool uploadDone() const { return uploaded == vertexCount*sizeof(TerrainVertex); }
+
+        const TerrainVertex* vertexData() const {
+            return cached ? reinterpret_cast<const TerrainVertex*>(cached->data() + cachedOffset)
+                          : staging.data();
+        }
+    };
+
+    // a tile's heights plus `ring` samples of its four edge neighbours, so
+    // finite differences on the border read the same terrain as the tile next
+    // door. only built while a tile is; the corners past both edges are unused
+    struct BorderedHeights {
+        std::vector<float> h;
+        long               size = 0, ring = 0;   // size = the tile's grid size
+        float at(long x, long z) const { return h[std::size_t((z+ring)*(size+2*ring) + x+ring)]; }
+    };
+
+    // recently generated heightmaps by tile key, least recently used last.
+    // a fresh build needs its own and its four neighbours' heights, and the
+    // neighbours build soon after, so each tile is generated about once.
+    // an entry goes in before its heights are done; other workers wait on it
+    struct HeightCache {
+        using Heights = std::shared_future<std::shared_ptr<const Heightfield>>;
+        struct Entry {
+            Heights                            heights;
+            std::list<std::uint64_t>::iterator use;
+        };
+        std::mutex                                mutex;
+        std::unordered_map<std::uint64_t, Entry>  entries;
+        std::list<std::uint64_t>                  order;
     };
 
-    std::vector<Tile>    _tiles;
+    // tiles keyed by packed (ix,iz)
+    std::unordered_map<std::uint64_t, Tile> _tiles;
+    std::unordered_map<std::uint64_t, std::future<std::unique_ptr<Tile>>> _pending;
+    std::deque<std::uint64_t> _uploadQueue;
+    std::uint64_t        _heightsVersion = 0;
+    // tile key -> _heightsVersion when it last appeared or went away, for
+    // changes newer than _changeHorizon; older entries are dropped
+    std::unordered_map<std::uint64_t, std::uint64_t> _tileVersions;
+    // _heightsVersion after each of the last kChangeHistory updates
+    std::deque<std::uint64_t> _versionHistory;
+    std::uint64_t        _changeHorizon = 0;
+    int                  _viewRadius = 1;
+    std::size_t          _uploadBudget = 4u << 20;
+    glm::vec3            _lastCamPos = glm::vec3(0.0f);
+    glm::vec2            _travelDir  = glm::vec2(0.0f);
     int                  _lodLevels;
     std::size_t          _tileSize;
     float                _scale, _heightScale, _smoothness, _yOffset;
+    std::uint32_t        _seed;
 
     // only two textures now
-    GLuint               _albedo, _normal;
+    TextureHandle        _albedo, _normal;
+
+    // patch shared by every node: _patchRes quads per side
+    std::size_t          _patchRes = 0;
+    GridIndexBuffer      _patch;
+
+    // per level: max node error, AABB diagonal and the resulting split range.
+    // error/diag only grow as tiles arrive so every tile uses the same ranges
+    std::vector<float>   _levelError, _levelDiag, _lodRange;
+    float                _pixelError = 2.0f;
+    std::size_t          _lastTriangles = 0;
 
     FastNoiseLite        _detailNoise;
+    mutable HeightCache  _heightCache;
 
     // init steps:
     void initializeNoise();
-    void initializeTextures(const std::string& a, const std::string& n);
+    void initializeTextures(AssetLoader& assets, const std::string& a, const std::string& n);
     void initializeTiles();
 
-    void generateLODs(Tile& tile);
-    void buildTileMesh(Tile& tile, TileLOD& lod, std::size_t resolution);
-    void loadTexture(const std::string& path, GLuint& texID);
+    static std::uint64_t tileKey(int ix, int iz);
+    int  tileCoord(float world) const;
+    // worker side: heightmap + quadtree + vertices, no GL
+    std::unique_ptr<Tile> buildTile(int ix, int iz) const;
+    void generateHeights(Heightfield& hf, int ix, int iz) const;
+    std::shared_ptr<const Heightfield> generatedHeights(int ix, int iz) const;
+    BorderedHeights borderedHeights(const Tile& tile) const;
+    // versioned on-disk copy of a built tile, keyed by every build parameter
+    std::string cachePath(int ix, int iz) const;
+    std::unique_ptr<Tile> loadCachedTile(int ix, int iz) const;
+    void saveCachedTile(const Tile& tile) const;
+    void buildNode(Tile& tile, const BorderedHeights& B, int index, int level,
+                   std::size_t x0, std::size_t z0) const;
+    void buildNormalGrid(Tile& tile, const BorderedHeights& B) const;
+    void sampleTile(const Tile& tile, const glm::vec2* xz, std::size_t count,
+                    float* heights, glm::vec3* normals) const;
+    // level-major node/vertex order, see buildTile
+    std::size_t firstNodeOfLevel(int level) const;
+    std::size_t levelVertexEnd(int level) const;
+    // GL side
+    void beginUpload(Tile& tile);
+    std::size_t uploadSlice(Tile& tile, std::size_t maxBytes);
+    void releaseTile(Tile& tile);
+    void updateLodRanges(float fovY, float viewportHeight);
+
+    // last member: joined first, before anything its jobs read goes away
+    ThreadPool           _workers;
 };
 
 #endif // LOD_TERRAIN_H
@@ -5,41 +5,44 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include "../lib/FastNoiseLite.h"
+#include "heightfield.h"
+#include "terrainVertex.h"
+#include "gridIndices.h"
+#include "../ultis/shaderReader.h"
 
 class Terrain {
 public:
     Terrain(std::size_t size, float scale, float heightScale,
             const std::string& albedoPath, const std::string& normalPath,
             const std::string& roughnessPath, const std::string& aoPath,
-            float smoothness);
+            float smoothness, std::uint32_t seed = 1337);
     ~Terrain();
 
-    void Draw();
+    // shader must be bound; Draw sets the grid placement uniforms
+    // (heightRange, patchInfo, nodeXform, morphRange) on it
+    void Draw(const Shader& shader);
     void Cleanup();
 
 private:
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec2 texCoord;
-        glm::vec3 normal;
-    };
-
     void buildMesh();
     void loadTexture(const std::string& path, GLuint& texID);
-    void addRivers(std::vector<Vertex>& verts);
+    void addRivers(Heightfield& H);
 
     std::size_t size_;      // number of quads per side
     float scale_;           // world-space width/depth
     float heightScale_;     // vertical exaggeration
     float smoothness_;      // fractal exponent
+    std::uint32_t seed_;    // diamond–square seed, fixed for reproducible runs
 
     FastNoiseLite detailNoise_;
     FastNoiseLite riverNoise_;
 
-    GLuint vao_, vbo_, ebo_;
-    std::size_t indexCount_;
+    TerrainHeightRange heights_;  // quantization range of the packed heights
+    GLuint vao_, vbo_;
+    GridIndexBuffer indices_;     // shared, see gridIndices.h
     GLuint albedoTex_, normalTex_, roughnessTex_, aoTex_;
 };
 
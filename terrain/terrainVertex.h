@@ -0,0 +1,67 @@
+#ifndef TERRAIN_VERTEX_H
+#define TERRAIN_VERTEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "../lib/glad.h"
+
+// 8-byte terrain vertex shared by Terrain and LodTerrain.
+// Only what the grid cannot rebuild is stored: x/z (and so the UV) come from
+// gl_VertexID in terrain.vs, see the nodeXform/patchInfo uniforms there.
+//   height, morphHeight: unorm16 over the mesh's [min, min+extent] height range
+//   normal, morphNormal: octahedral snorm8x2, +y folded to the centre
+// morph* is the parent LOD surface at this x/z; meshes without LOD repeat
+// their own values.
+struct TerrainVertex {
+    std::uint16_t height, morphHeight;
+    std::int8_t   normal[2], morphNormal[2];
+};
+static_assert(sizeof(TerrainVertex) == 8, "terrain vertex must stay 8 bytes");
+
+// height range of one mesh, passed to terrain.vs as `heightRange`
+struct TerrainHeightRange {
+    float min = 0.0f, extent = 1.0f;
+
+    std::uint16_t quantize(float h) const {
+        float t = (h - min) / extent;
+        return std::uint16_t(std::lround(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f));
+    }
+};
+
+// unit vector -> two snorm8, matching octDecode in the terrain shaders
+inline void octEncode(const glm::vec3& n, std::int8_t out[2]){
+    // fold around y (the up axis), so near-flat normals get the finest steps
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    float u = n.x / l1, v = n.z / l1;
+    if(n.y < 0.0f){
+        float fu = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float fv = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu; v = fv;
+    }
+    out[0] = std::int8_t(std::lround(std::min(std::max(u, -1.0f), 1.0f) * 127.0f));
+    out[1] = std::int8_t(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 127.0f));
+}
+
+inline TerrainVertex packTerrainVertex(const TerrainHeightRange& r,
+                                       float h, const glm::vec3& n,
+                                       float morphH, const glm::vec3& morphN){
+    TerrainVertex v;
+    v.height      = r.quantize(h);
+    v.morphHeight = r.quantize(morphH);
+    octEncode(n, v.normal);
+    octEncode(morphN, v.morphNormal);
+    return v;
+}
+
+// attribute layout for the bound VAO/VBO (location 0: heights, 1: normals)
+inline void setupTerrainVertexAttribs(){
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0,2,GL_UNSIGNED_SHORT,GL_TRUE,sizeof(TerrainVertex),(void*)offsetof(TerrainVertex,height));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1,4,GL_BYTE,GL_TRUE,sizeof(TerrainVertex),(void*)offsetof(TerrainVertex,normal));
+}
+
+#endif // TERRAIN_VERTEX_H
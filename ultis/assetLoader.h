@@ -0,0 +1,394 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include "../lib/glad.h"
+#include "../lib/stb_image.h"
+#include "threadPool.h"
+#include "textureHandle.h"
+#include "ktxTexture.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// how a texture is sampled; part of what makes two loads the same texture
+struct TextureOptions {
+    GLint wrap         = GL_REPEAT;
+    bool  mipmaps      = true;    // trilinear with a full chain, else plain linear
+    bool  clampIfAlpha = false;   // images with alpha get GL_CLAMP_TO_EDGE instead (foliage cards)
+};
+
+// Loads assets on a worker pool and hands them to GL on the GL thread.
+//
+// Requests are made on the GL thread and return at once: images are decoded
+// (stbi_load) and models imported concurrently, each finished job queues its
+// GL half, and upload() runs those halves, copying pixels through a pixel
+// unpack buffer so glTexImage2D doesn't have to read client memory.
+// A texture's name exists from the request on and stays incomplete (samples
+// black) until its upload; finish() drains everything, e.g. before the first
+// frame.
+//
+// Where S3TC is available, images go up block-compressed with a mip chain
+// built on the CPU (KtxTexture): the first load encodes and writes
+// "<image>.ktx" next to the image, later loads map that file instead of
+// decoding, and nothing calls glGenerateMipmap.
+//
+// Textures are shared: a request for a file (by canonical path) with the same
+// options as a live texture hands out that texture instead of loading it
+// again. Handles are counted, and the last one to go deletes the texture, so
+// objects keep their TextureHandle for as long as they draw with it.
+class AssetLoader
+{
+public:
+    // threads = 0 -> ThreadPool's default
+    explicit AssetLoader(unsigned threads = 0) : compressTextures(hasS3tc()), workers(threads) {}
+
+    ~AssetLoader()
+    {
+        if (pbo) glDeleteBuffers(1, &pbo);
+    }
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // a 2D texture from an image file; ready (optional) runs once it is
+    // uploaded, right away if it already is
+    TextureHandle texture(const std::string& path, const TextureOptions& options = {},
+                          std::function<void(GLuint)> ready = {})
+    {
+        return acquire(GL_TEXTURE_2D, {path}, options, std::move(ready));
+    }
+
+    // a cube map from six faces (+x, -x, +y, -y, +z, -z), decoded in parallel
+    TextureHandle cubemap(const std::vector<std::string>& faces, const TextureOptions& options = {},
+                          std::function<void(GLuint)> ready = {})
+    {
+        return acquire(GL_TEXTURE_CUBE_MAP, faces, options, std::move(ready));
+    }
+
+    // distinct textures alive
+    std::size_t textureCount() const { return registry->size(); }
+
+    // runs work() on a worker, then done(result) on the GL thread (in upload)
+    template<class T>
+    void run(std::function<T()> work, std::function<void(T&)> done)
+    {
+        ++inFlight;
+        workers.submit([this, work = std::move(work), done = std::move(done)]() {
+            try {
+                auto result = std::make_shared<T>(work());
+                post(0, [result, done]() { done(*result); });
+            } catch (const std::exception& e) {
+                std::cerr << "Asset job failed: " << e.what() << "\n";
+                post(0, [] {});
+            }
+        });
+    }
+
+    // GL thread: runs finished jobs until about maxBytes of pixels went up
+    // (at least one job); returns how many ran
+    std::size_t upload(std::size_t maxBytes = SIZE_MAX)
+    {
+        std::size_t ran = 0, bytes = 0;
+        while (bytes < maxBytes) {
+            Finished job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished.empty()) break;
+                job = std::move(finished.front());
+                finished.pop_front();
+            }
+            job.run();
+            bytes += job.bytes;
+            ++ran;
+            --inFlight;
+        }
+        return ran;
+    }
+
+    // GL thread: uploads until nothing is queued or decoding, including the
+    // jobs that finished jobs queue in turn
+    void finish()
+    {
+        for (;;) {
+            upload();
+            std::unique_lock<std::mutex> lock(mutex);
+            if (inFlight == 0) return;
+            wake.wait(lock, [this] { return !finished.empty(); });
+        }
+    }
+
+    // requests not uploaded yet
+    std::size_t pending() const { return inFlight; }
+
+    // BCn + KTX cache for textures requested from now on; off (plain RGB(A)
+    // and glGenerateMipmap) when the driver lacks S3TC
+    bool compressTextures;
+
+private:
+    // decoded pixels, or the compressed mip chain when compressTextures is on
+    struct Image {
+        int width = 0, height = 0, channels = 0;
+        std::unique_ptr<unsigned char, void (*)(void*)> pixels{nullptr, stbi_image_free};
+        KtxTexture compressed;
+
+        bool loaded() const { return pixels || compressed.valid(); }
+        std::size_t bytes() const
+        {
+            return compressed.valid() ? compressed.size() : std::size_t(width) * height * channels;
+        }
+    };
+
+    // one registered texture; handles point at id
+    struct Entry {
+        GLuint      id = 0;
+        std::string key;
+        bool        uploaded = false;
+        std::vector<std::function<void(GLuint)>> waiting;   // ready callbacks until then
+    };
+    // key -> entry, GL thread only; entries drop out as their last handle goes
+    using Registry = std::unordered_map<std::string, std::weak_ptr<Entry>>;
+
+    struct Request {
+        std::shared_ptr<Entry>      entry;   // keeps the texture while in flight
+        GLenum                      target = GL_TEXTURE_2D;
+        TextureOptions              options;
+        std::vector<std::string>    paths;
+        std::vector<Image>          images;
+        std::atomic<int>            remaining{0};
+    };
+
+    struct Finished {
+        std::size_t           bytes = 0;
+        std::function<void()> run;
+    };
+
+    static GLenum formatOf(int channels)
+    {
+        switch (channels) {
+        case 1:  return GL_RED;
+        case 2:  return GL_RG;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    static std::string canonical(const std::string& path)
+    {
+        std::error_code ec;
+        std::filesystem::path p = std::filesystem::weakly_canonical(path, ec);
+        return ec ? std::filesystem::path(path).lexically_normal().string() : p.string();
+    }
+
+    // target, files and options: whatever makes two textures differ
+    static std::string keyOf(GLenum target, const std::vector<std::string>& paths, const TextureOptions& o)
+    {
+        std::string key = std::to_string(target) + '|' + std::to_string(o.wrap) + '|'
+                        + char('0' + o.mipmaps) + char('0' + o.clampIfAlpha);
+        for (const std::string& path : paths)
+            key += '|' + canonical(path);
+        return key;
+    }
+
+    TextureHandle acquire(GLenum target, const std::vector<std::string>& paths, const TextureOptions& options,
+                          std::function<void(GLuint)> ready)
+    {
+        std::string key = keyOf(target, paths, options);
+        auto found = registry->find(key);
+        if (found != registry->end()) {
+            if (std::shared_ptr<Entry> entry = found->second.lock()) {
+                if (ready) {
+                    if (entry->uploaded) ready(entry->id);
+                    else entry->waiting.push_back(std::move(ready));
+                }
+                return TextureHandle(std::shared_ptr<const GLuint>(entry, &entry->id));
+            }
+        }
+
+        // the last handle deletes the texture and its registry slot (unless
+        // the loader went first)
+        std::weak_ptr<Registry> owner = registry;
+        std::shared_ptr<Entry> entry(new Entry, [owner](Entry* e) {
+            glDeleteTextures(1, &e->id);
+            if (auto reg = owner.lock()) {
+                auto it = reg->find(e->key);
+                if (it != reg->end() && it->second.expired()) reg->erase(it);
+            }
+            delete e;
+        });
+        glGenTextures(1, &entry->id);
+        entry->key = key;
+        if (ready) entry->waiting.push_back(std::move(ready));
+        (*registry)[key] = entry;
+
+        request(entry, target, paths, options);
+        return TextureHandle(std::shared_ptr<const GLuint>(entry, &entry->id));
+    }
+
+    void request(const std::shared_ptr<Entry>& entry, GLenum target, const std::vector<std::string>& paths,
+                 const TextureOptions& options)
+    {
+        auto req = std::make_shared<Request>();
+        req->entry   = entry;
+        req->target  = target;
+        req->options = options;
+        req->paths   = paths;
+        req->images.resize(paths.size());
+        req->remaining = int(paths.size());
+
+        // one decode per image; the last one to finish queues the upload
+        ++inFlight;
+        bool compress = compressTextures;
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            workers.submit([this, req, i, compress]() {
+                load(req->paths[i], req->images[i], compress);
+                if (--req->remaining == 0) {
+                    std::size_t bytes = 0;
+                    for (const Image& im : req->images) bytes += im.bytes();
+                    post(bytes, [this, req]() { uploadTexture(*req); });
+                }
+            });
+        }
+    }
+
+    // worker side: the cached KTX if it is current, else decode (and, when
+    // compressing, encode and write the KTX for next time)
+    static void load(const std::string& path, Image& img, bool compress)
+    {
+        if (compress && KtxTexture::upToDate(path) && img.compressed.load(KtxTexture::pathFor(path))) {
+            img.width    = img.compressed.width;
+            img.height   = img.compressed.height;
+            img.channels = img.compressed.channels();
+            return;
+        }
+        img.pixels.reset(stbi_load(path.c_str(), &img.width, &img.height, &img.channels, 0));
+        if (!img.pixels) {
+            std::cerr << "Failed to load " << path << "\n";
+            return;
+        }
+        if (compress) {
+            img.compressed = KtxTexture::encode(img.pixels.get(), img.width, img.height, img.channels);
+            img.compressed.save(KtxTexture::pathFor(path));
+            img.pixels.reset();
+        }
+    }
+
+    static bool hasS3tc()
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+            if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) return true;
+        }
+        return false;
+    }
+
+    void post(std::size_t bytes, std::function<void()> run)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(Finished{bytes, std::move(run)});
+        }
+        wake.notify_one();
+    }
+
+    void uploadTexture(Request& req)
+    {
+        if (!pbo) glGenBuffers(1, &pbo);
+        glBindTexture(req.target, req.entry->id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);   // RGB rows are not 4-byte aligned
+
+        const TextureOptions& o = req.options;
+        bool alpha = false, generateMips = false;
+        int  topLevel = 0;
+        for (std::size_t i = 0; i < req.images.size(); ++i) {
+            const Image& img = req.images[i];
+            if (!img.loaded()) continue;
+            alpha |= img.channels == 4;
+            GLenum face = req.target == GL_TEXTURE_CUBE_MAP ? GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i) : req.target;
+
+            // the levels that go up, packed back to back in the buffer
+            const KtxTexture& k = img.compressed;
+            std::size_t levels = k.valid() ? (o.mipmaps ? k.levels.size() : 1) : 1;
+            std::size_t bytes  = 0;
+            for (std::size_t l = 0; l < levels; ++l)
+                bytes += k.valid() ? k.levels[l].size : img.bytes();
+
+            // orphan and refill: the driver keeps the previous contents alive
+            // for a copy still in flight
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_DRAW);
+            auto* dst = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(bytes),
+                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (!dst) continue;
+            if (k.valid()) {
+                std::size_t offset = 0;
+                for (std::size_t l = 0; l < levels; ++l) {
+                    std::memcpy(dst + offset, k.bytes() + k.levels[l].offset, k.levels[l].size);
+                    offset += k.levels[l].size;
+                }
+            } else {
+                std::memcpy(dst, img.pixels.get(), bytes);
+            }
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            if (k.valid()) {
+                std::size_t offset = 0;
+                for (std::size_t l = 0; l < levels; ++l) {
+                    const KtxTexture::Level& lv = k.levels[l];
+                    glCompressedTexImage2D(face, GLint(l), k.format, lv.width, lv.height, 0, GLsizei(lv.size),
+                                           reinterpret_cast<const void*>(offset));
+                    offset += lv.size;
+                }
+                topLevel = int(levels) - 1;
+            } else {
+                GLenum format = formatOf(img.channels);
+                glTexImage2D(face, 0, format, img.width, img.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+                generateMips = o.mipmaps;
+            }
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        GLint wrap = o.clampIfAlpha && alpha ? GL_CLAMP_TO_EDGE : o.wrap;
+        glTexParameteri(req.target, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(req.target, GL_TEXTURE_WRAP_T, wrap);
+        if (req.target == GL_TEXTURE_CUBE_MAP)
+            glTexParameteri(req.target, GL_TEXTURE_WRAP_R, wrap);
+        glTexParameteri(req.target, GL_TEXTURE_MIN_FILTER, o.mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(req.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (generateMips) glGenerateMipmap(req.target);
+        else glTexParameteri(req.target, GL_TEXTURE_MAX_LEVEL, topLevel);
+
+        req.images.clear();
+        Entry& entry = *req.entry;
+        entry.uploaded = true;
+        for (auto& ready : entry.waiting) ready(entry.id);
+        entry.waiting.clear();
+        req.entry.reset();
+    }
+
+    GLuint                   pbo = 0;
+    std::shared_ptr<Registry> registry = std::make_shared<Registry>();
+    std::atomic<std::size_t> inFlight{0};
+    std::deque<Finished>     finished;
+    std::mutex               mutex;
+    std::condition_variable  wake;
+
+    // last member: joined first, before anything its jobs touch goes away
+    ThreadPool               workers;
+};
+
+#endif // ASSET_LOADER_H
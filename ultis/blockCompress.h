@@ -0,0 +1,222 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include "../lib/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// EXT_texture_compression_s3tc; the generated glad only has core enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// CPU side of block-compressed textures: a box-filtered mip chain and a
+// small BCn encoder, one format per channel count:
+//   1 -> BC4 (RGTC1)   2 -> BC5 (RGTC2)   3 -> BC1 (DXT1)   4 -> BC3 (DXT5)
+// Colour endpoints come from the block's principal axis, alpha/red/green
+// endpoints from its range; every texel then takes the nearest palette entry.
+// Good enough for albedo and detail maps, and it runs once per texture (the
+// result is cached, see KtxTexture).
+namespace BlockCompress
+{
+    inline GLenum formatFor(int channels)
+    {
+        switch (channels) {
+        case 1:  return GL_COMPRESSED_RED_RGTC1;
+        case 2:  return GL_COMPRESSED_RG_RGTC2;
+        case 3:  return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        default: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        }
+    }
+
+    // 0 for formats this encoder doesn't write
+    inline int channelsOf(GLenum format)
+    {
+        switch (format) {
+        case GL_COMPRESSED_RED_RGTC1:           return 1;
+        case GL_COMPRESSED_RG_RGTC2:            return 2;
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:   return 3;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:  return 4;
+        default:                                return 0;
+        }
+    }
+
+    inline std::size_t blockBytes(GLenum format)
+    {
+        return format == GL_COMPRESSED_RED_RGTC1 || format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+    }
+
+    inline std::size_t levelBytes(GLenum format, int width, int height)
+    {
+        return std::size_t((width + 3) / 4) * std::size_t((height + 3) / 4) * blockBytes(format);
+    }
+
+    // next mip level: each texel averages the 2x2 texels above it (edges
+    // repeat on odd sizes)
+    inline std::vector<unsigned char> downsample(const unsigned char* src, int width, int height, int channels,
+                                                 int& outWidth, int& outHeight)
+    {
+        outWidth  = std::max(1, width / 2);
+        outHeight = std::max(1, height / 2);
+        std::vector<unsigned char> dst(std::size_t(outWidth) * outHeight * channels);
+        for (int y = 0; y < outHeight; ++y) {
+            int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            for (int x = 0; x < outWidth; ++x) {
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                for (int c = 0; c < channels; ++c) {
+                    int sum = src[(std::size_t(y0) * width + x0) * channels + c]
+                            + src[(std::size_t(y0) * width + x1) * channels + c]
+                            + src[(std::size_t(y1) * width + x0) * channels + c]
+                            + src[(std::size_t(y1) * width + x1) * channels + c];
+                    dst[(std::size_t(y) * outWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        return dst;
+    }
+
+    // 16 values of one channel -> 8 bytes (BC4; also BC3 alpha and BC5 halves)
+    inline void encodeChannel(const unsigned char v[16], unsigned char out[8])
+    {
+        int lo = 255, hi = 0;
+        for (int i = 0; i < 16; ++i) { lo = std::min(lo, int(v[i])); hi = std::max(hi, int(v[i])); }
+        // hi > lo selects the eight-value palette: hi, lo, then six steps between
+        int palette[8] = {hi, lo};
+        for (int k = 1; k <= 6; ++k) palette[k + 1] = ((7 - k) * hi + k * lo + 3) / 7;
+
+        std::uint64_t bits = 0;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestErr = 1 << 30;
+            for (int k = 0; k < 8; ++k) {
+                int err = std::abs(int(v[i]) - palette[k]);
+                if (err < bestErr) { bestErr = err; best = k; }
+            }
+            bits |= std::uint64_t(best) << (3 * i);
+        }
+        out[0] = (unsigned char)hi;
+        out[1] = (unsigned char)lo;
+        for (int b = 0; b < 6; ++b) out[2 + b] = (unsigned char)(bits >> (8 * b));
+    }
+
+    inline std::uint16_t pack565(const float c[3])
+    {
+        int r = std::clamp(int(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+        int g = std::clamp(int(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+        int b = std::clamp(int(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+        return std::uint16_t((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpack565(std::uint16_t p, int c[3])
+    {
+        int r = (p >> 11) & 31, g = (p >> 5) & 63, b = p & 31;
+        c[0] = (r << 3) | (r >> 2);
+        c[1] = (g << 2) | (g >> 4);
+        c[2] = (b << 3) | (b >> 2);
+    }
+
+    // 16 RGB texels (3 bytes apart) -> 8 bytes, four-colour BC1 block
+    inline void encodeColor(const unsigned char rgb[16 * 3], unsigned char out[8])
+    {
+        float mean[3] = {0, 0, 0};
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c) mean[c] += rgb[i * 3 + c] / 16.0f;
+        float cov[6] = {0, 0, 0, 0, 0, 0};   // xx xy xz yy yz zz
+        for (int i = 0; i < 16; ++i) {
+            float d[3] = {rgb[i * 3] - mean[0], rgb[i * 3 + 1] - mean[1], rgb[i * 3 + 2] - mean[2]};
+            cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+        }
+        // principal axis by power iteration, starting from luminance
+        float axis[3] = {0.30f, 0.59f, 0.11f};
+        for (int it = 0; it < 8; ++it) {
+            float n[3] = {cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                          cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                          cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+            float len = std::max({std::abs(n[0]), std::abs(n[1]), std::abs(n[2])});
+            if (len < 1e-6f) break;   // flat block
+            for (int c = 0; c < 3; ++c) axis[c] = n[c] / len;
+        }
+        float norm = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        for (int c = 0; c < 3; ++c) axis[c] /= norm;
+        float lo = 1e30f, hi = -1e30f;
+        for (int i = 0; i < 16; ++i) {
+            float t = 0;
+            for (int c = 0; c < 3; ++c) t += (rgb[i * 3 + c] - mean[c]) * axis[c];
+            lo = std::min(lo, t); hi = std::max(hi, t);
+        }
+        // pull the ends in a little: they are rarely hit exactly
+        float inset = (hi - lo) / 16.0f;
+        float e0[3], e1[3];
+        for (int c = 0; c < 3; ++c) {
+            e0[c] = mean[c] + axis[c] * (hi - inset);
+            e1[c] = mean[c] + axis[c] * (lo + inset);
+        }
+        std::uint16_t c0 = pack565(e0), c1 = pack565(e1);
+        if (c0 < c1) std::swap(c0, c1);   // c0 > c1: four-colour mode
+
+        std::uint32_t bits = 0;
+        if (c0 != c1) {
+            int p[4][3];
+            unpack565(c0, p[0]);
+            unpack565(c1, p[1]);
+            for (int c = 0; c < 3; ++c) {
+                p[2][c] = (2 * p[0][c] + p[1][c] + 1) / 3;
+                p[3][c] = (p[0][c] + 2 * p[1][c] + 1) / 3;
+            }
+            for (int i = 0; i < 16; ++i) {
+                int best = 0, bestErr = 1 << 30;
+                for (int k = 0; k < 4; ++k) {
+                    int dr = rgb[i * 3] - p[k][0], dg = rgb[i * 3 + 1] - p[k][1], db = rgb[i * 3 + 2] - p[k][2];
+                    int err = dr * dr + dg * dg + db * db;
+                    if (err < bestErr) { bestErr = err; best = k; }
+                }
+                bits |= std::uint32_t(best) << (2 * i);
+            }
+        }
+        out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+        for (int b = 0; b < 4; ++b) out[4 + b] = (unsigned char)(bits >> (8 * b));
+    }
+
+    // one whole level; out must hold levelBytes(formatFor(channels), width, height)
+    inline void encode(const unsigned char* pixels, int width, int height, int channels, unsigned char* out)
+    {
+        GLenum format = formatFor(channels);
+        for (int by = 0; by < height; by += 4) {
+            for (int bx = 0; bx < width; bx += 4) {
+                // gather the 4x4 block, repeating edge texels past the border
+                unsigned char texel[16][4] = {};
+                for (int i = 0; i < 16; ++i) {
+                    int x = std::min(bx + i % 4, width - 1), y = std::min(by + i / 4, height - 1);
+                    std::memcpy(texel[i], pixels + (std::size_t(y) * width + x) * channels, channels);
+                }
+                unsigned char channel[16], rgb[16 * 3];
+                auto take = [&](int c) { for (int i = 0; i < 16; ++i) channel[i] = texel[i][c]; };
+                unsigned char* block = out;
+                out += blockBytes(format);
+                if (format == GL_COMPRESSED_RED_RGTC1) {
+                    take(0); encodeChannel(channel, block);
+                } else if (format == GL_COMPRESSED_RG_RGTC2) {
+                    take(0); encodeChannel(channel, block);
+                    take(1); encodeChannel(channel, block + 8);
+                } else {
+                    for (int i = 0; i < 16; ++i) std::memcpy(rgb + i * 3, texel[i], 3);
+                    if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+                        take(3); encodeChannel(channel, block);   // alpha first, then colour
+                        block += 8;
+                    }
+                    encodeColor(rgb, block);
+                }
+            }
+        }
+    }
+}
+
+#endif // BLOCK_COMPRESS_H
@@ -4,6 +4,7 @@
 #include "../lib/glad.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "frustum.h"
 
 enum Camera_Movement {
     FORWARD,
@@ -66,6 +67,21 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // view matrix of this camera mirrored in the horizontal plane y = planeY
+    // (planar reflections); the camera itself is left untouched
+    glm::mat4 GetReflectionViewMatrix(float planeY) const
+    {
+        glm::vec3 pos(Position.x, 2.0f * planeY - Position.y, Position.z);
+        glm::vec3 front(Front.x, -Front.y, Front.z);
+        return glm::lookAt(pos, pos + front, WorldUp);
+    }
+
+    // culling planes of the view through `projection`
+    Frustum GetFrustum(const glm::mat4& projection)
+    {
+        return Frustum(projection * GetViewMatrix());
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
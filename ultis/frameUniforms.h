@@ -0,0 +1,58 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "shaderReader.h"
+
+// Data shared by the terrain, lit and water shaders, uploaded once per frame
+// (FrameBlock) or once per pass (CameraBlock) instead of as loose uniforms on
+// every program. The GLSL side declares the same blocks with layout(std140);
+// keep both in sync.
+
+const unsigned int kCameraBlockBinding = 0;
+const unsigned int kFrameBlockBinding  = 1;
+
+// sun shadow cascades (object/shadowCascades.h); SHADOW_CASCADES in the shaders
+const int kShadowCascades = 4;
+
+// layout(std140) uniform Camera
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;      float pad0;
+    glm::vec2 clusterDepth; float pad1[2];   // LightClusters::depthParams()
+};
+
+// layout(std140) uniform Frame
+struct FrameBlock {
+    // sun
+    glm::mat4    cascadeMatrices[kShadowCascades];   // world -> light clip space
+    glm::vec4    cascadeBias;                        // depth bias per cascade
+    glm::vec3    lightPos;      float        dayFactor;
+    glm::vec3    lightDir;      float        ambientStrength;   // lightDir points down from the sun
+    glm::vec3    lightColor;    std::int32_t shadowsEnabled;    // GLSL bool
+    // water tint
+    glm::vec3    shallowColor;  float        waterHeight;
+    glm::vec3    deepColor;     float        maxDepth;
+    // fog
+    glm::vec3    fogColor;      float        fogStart;
+    float        fogEnd;        std::int32_t shadowFilter;      // ShadowCascades::Filter
+    float        pad0[2];
+};
+
+static_assert(offsetof(CameraBlock, clusterDepth) == 144 && sizeof(CameraBlock) == 160,
+              "CameraBlock must match std140");
+static_assert(offsetof(FrameBlock, lightPos) == 272 && offsetof(FrameBlock, shallowColor) == 320
+              && offsetof(FrameBlock, fogEnd) == 368 && sizeof(FrameBlock) == 384,
+              "FrameBlock must match std140");
+
+// hook a program's Camera/Frame blocks (if it declares them) to the shared buffers
+inline void bindFrameBlocks(const Shader& shader)
+{
+    shader.bindUniformBlock("Camera", kCameraBlockBinding);
+    shader.bindUniformBlock("Frame",  kFrameBlockBinding);
+}
+
+#endif // FRAME_UNIFORMS_H
@@ -0,0 +1,134 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct BoundingBox {
+    glm::vec3 min = glm::vec3( 1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    void expand(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+    void expand(const BoundingBox& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+    bool empty() const { return min.x > max.x; }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float     radius = 0.0f;
+
+    // sphere around the box (not the tightest, but never smaller)
+    static BoundingSphere around(const BoundingBox& b) {
+        if (b.empty()) return BoundingSphere{};
+        return BoundingSphere{0.5f * (b.min + b.max), 0.5f * glm::length(b.max - b.min)};
+    }
+};
+
+// The six planes (Gribb–Hartmann) of a view-projection matrix, normalized so
+// that dot(plane, vec4(p, 1)) is the signed distance of p, positive inside.
+// Works for perspective and orthographic matrices alike.
+struct Frustum {
+    glm::vec4 planes[6];   // left, right, bottom, top, near, far
+
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& m) {
+        glm::vec4 r[4];
+        for (int i = 0; i < 4; ++i) r[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        planes[0] = r[3] + r[0]; planes[1] = r[3] - r[0];
+        planes[2] = r[3] + r[1]; planes[3] = r[3] - r[1];
+        planes[4] = r[3] + r[2]; planes[5] = r[3] - r[2];
+        for (glm::vec4& p : planes) p /= glm::length(glm::vec3(p));
+    }
+
+    // false only if the box is fully behind one plane
+    bool intersects(const glm::vec3& lo, const glm::vec3& hi) const {
+        for (const glm::vec4& p : planes) {
+            glm::vec3 v(p.x > 0 ? hi.x : lo.x, p.y > 0 ? hi.y : lo.y, p.z > 0 ? hi.z : lo.z);
+            if (p.x*v.x + p.y*v.y + p.z*v.z + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+    bool intersects(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& p : planes)
+            if (p.x*center.x + p.y*center.y + p.z*center.z + p.w < -radius) return false;
+        return true;
+    }
+};
+
+// World-space bounding spheres, one array per component so four can be
+// tested per SSE step.
+struct SphereSet {
+    std::vector<float> x, y, z, r;
+
+    void clear() { x.clear(); y.clear(); z.clear(); r.clear(); }
+    void push(const glm::vec3& c, float radius) {
+        x.push_back(c.x); y.push_back(c.y); z.push_back(c.z); r.push_back(radius);
+    }
+    void set(std::size_t i, const glm::vec3& c, float radius) {
+        x[i] = c.x; y[i] = c.y; z[i] = c.z; r[i] = radius;
+    }
+    std::size_t size() const { return x.size(); }
+};
+
+// Replaces `visible` with the indices of the spheres that touch the frustum
+// and, if maxDistance > 0, come within maxDistance of eye.
+inline void cullSpheres(const Frustum& frustum, const SphereSet& spheres,
+                        std::vector<std::uint32_t>& visible,
+                        const glm::vec3& eye = glm::vec3(0.0f), float maxDistance = 0.0f)
+{
+    visible.clear();
+    const std::size_t n = spheres.size();
+    const bool byDistance = maxDistance > 0.0f;
+    auto inside = [&](std::size_t i) {
+        glm::vec3 c(spheres.x[i], spheres.y[i], spheres.z[i]);
+        float r = spheres.r[i];
+        if (byDistance) {
+            glm::vec3 d = c - eye;
+            float reach = maxDistance + r;
+            if (glm::dot(d, d) > reach * reach) return false;
+        }
+        return frustum.intersects(c, r);
+    };
+
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const __m128 ex = _mm_set1_ps(eye.x), ey = _mm_set1_ps(eye.y), ez = _mm_set1_ps(eye.z);
+    const __m128 vFar = _mm_set1_ps(maxDistance);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(&spheres.x[i]), y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 z = _mm_loadu_ps(&spheres.z[i]), r = _mm_loadu_ps(&spheres.r[i]);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        // lanes stay set while every plane distance is >= -r
+        __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                                  _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            in = _mm_and_ps(in, _mm_cmpge_ps(d, negR));
+        }
+        if (byDistance) {
+            __m128 dx = _mm_sub_ps(x, ex), dy = _mm_sub_ps(y, ey), dz = _mm_sub_ps(z, ez);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 reach = _mm_add_ps(vFar, r);
+            in = _mm_and_ps(in, _mm_cmple_ps(d2, _mm_mul_ps(reach, reach)));
+        }
+        int mask = _mm_movemask_ps(in);
+        for (int l = 0; l < 4; ++l)
+            if (mask & (1 << l)) visible.push_back(std::uint32_t(i + l));
+    }
+#endif
+    for (; i < n; ++i)
+        if (inside(i)) visible.push_back(std::uint32_t(i));
+}
+
+#endif // FRUSTUM_H
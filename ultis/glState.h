@@ -0,0 +1,93 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "../lib/glad.h"
+
+// Shadow copy of the bindings a draw loop keeps changing: the program, the
+// VAO, the active texture unit and the 2D texture on each unit. A bind that
+// matches the copy is dropped instead of reaching the driver.
+//
+// Only valid while everything goes through it: code that calls glUseProgram,
+// glBindTexture etc. directly (terrain, water, sky, ImGui) leaves the copy
+// stale, so call invalidate() after such draws.
+class GLStateCache
+{
+public:
+    static const int kTextureUnits = 16;
+
+    struct Stats {
+        unsigned issued  = 0;   // binds that reached GL
+        unsigned skipped = 0;   // binds that matched the cached state
+    };
+
+    GLStateCache() { invalidate(); }
+
+    // forget everything; the next bind of each kind always goes through
+    void invalidate()
+    {
+        program = vao = kUnknown;
+        activeUnit = -1;
+        for (GLuint& t : textures) t = kUnknown;
+    }
+
+    // true if the program actually changed
+    bool useProgram(GLuint id)
+    {
+        if (id == program) { ++counts.skipped; return false; }
+        glUseProgram(id);
+        program = id;
+        ++counts.issued;
+        return true;
+    }
+
+    void bindVertexArray(GLuint id)
+    {
+        if (id == vao) { ++counts.skipped; return; }
+        glBindVertexArray(id);
+        vao = id;
+        ++counts.issued;
+    }
+
+    // true if the texture on that unit actually changed
+    bool bindTexture2D(int unit, GLuint id)
+    {
+        if (unit >= kTextureUnits) {   // untracked unit: always bind
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+            glBindTexture(GL_TEXTURE_2D, id);
+            ++counts.issued;
+            return true;
+        }
+        if (textures[unit] == id) { ++counts.skipped; return false; }
+        if (activeUnit != unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+        glBindTexture(GL_TEXTURE_2D, id);
+        textures[unit] = id;
+        ++counts.issued;
+        return true;
+    }
+
+    // leave unit 0 active, as code outside the cache expects
+    void resetActiveUnit()
+    {
+        if (activeUnit != 0) {
+            glActiveTexture(GL_TEXTURE0);
+            activeUnit = 0;
+        }
+    }
+
+    const Stats& stats() const { return counts; }
+    void resetStats() { counts = Stats{}; }
+
+private:
+    static const GLuint kUnknown = ~GLuint(0);
+
+    GLuint program, vao;
+    int    activeUnit;
+    GLuint textures[kTextureUnits];
+    Stats  counts;
+};
+
+#endif // GL_STATE_H
@@ -0,0 +1,70 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include "../lib/glad.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// Per-instance model matrices for instanced draws (Mesh::DrawInstanced,
+// Sphere::drawInstanced). The matrix occupies four attribute locations, one
+// column each, starting at kInstanceAttrib; shaders read it as
+//   layout(location = 7) in mat4 aInstanceModel;
+// Locations 0-3 are taken by the Mesh vertex layout (see VertexLayout).
+const GLuint kInstanceAttrib = 7;
+
+class InstanceBuffer
+{
+public:
+    InstanceBuffer()
+    {
+        glGenBuffers(1, &vbo);
+    }
+
+    ~InstanceBuffer()
+    {
+        glDeleteBuffers(1, &vbo);
+    }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // replace the transforms; grows the buffer when needed, orphans it otherwise
+    void update(const std::vector<glm::mat4>& transforms)
+    {
+        std::size_t bytes = transforms.size() * sizeof(glm::mat4);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (bytes > capacity) {
+            glBufferData(GL_ARRAY_BUFFER, bytes, transforms.data(), GL_DYNAMIC_DRAW);
+            capacity = bytes;
+        } else if (bytes) {
+            glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, transforms.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        instances = static_cast<GLsizei>(transforms.size());
+    }
+
+    // point the currently bound VAO's instance attributes at this buffer
+    void attach() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        for (GLuint c = 0; c < 4; ++c) {
+            glEnableVertexAttribArray(kInstanceAttrib + c);
+            glVertexAttribPointer(kInstanceAttrib + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void *)(c * sizeof(glm::vec4)));
+            glVertexAttribDivisor(kInstanceAttrib + c, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GLsizei count() const { return instances; }
+    GLuint  id() const    { return vbo; }
+
+private:
+    GLuint      vbo = 0;
+    std::size_t capacity = 0;
+    GLsizei     instances = 0;
+};
+
+#endif // INSTANCE_BUFFER_H
@@ -0,0 +1,81 @@
+#ifndef INSTANCE_SET_H
+#define INSTANCE_SET_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "frustum.h"
+#include "instanceBuffer.h"
+
+// What one pass draws of an InstanceSet: the visible subset, uploaded.
+struct VisibleInstances {
+    InstanceBuffer             buffer;
+    std::vector<std::uint32_t> indices;       // into the set, as in buffer
+    std::vector<std::uint32_t> candidates;    // scratch for the cull
+    std::uint64_t              setVersion = ~std::uint64_t(0);
+};
+
+// A fixed group of instances of one mesh: their transforms and world-space
+// bounding spheres. cull() picks out the instances a pass can see and uploads
+// just those; when the pass sees the same instances as last time, nothing is
+// uploaded at all.
+class InstanceSet {
+public:
+    // local: bounds of the mesh in model space
+    explicit InstanceSet(const BoundingSphere& local = BoundingSphere{}) : local(local) {}
+
+    void assign(const std::vector<glm::mat4>& transforms)
+    {
+        all = transforms;
+        world.clear();
+        for (const glm::mat4& M : all)
+            world.push(centerOf(M), radiusOf(M));
+        ++version;
+    }
+
+    // same instances, only transforms[i] for i in `changed` moved
+    void update(const std::vector<glm::mat4>& transforms, const std::vector<std::uint32_t>& changed)
+    {
+        for (std::uint32_t i : changed) {
+            all[i] = transforms[i];
+            world.set(i, centerOf(all[i]), radiusOf(all[i]));
+        }
+        if (!changed.empty()) ++version;
+    }
+
+    // eye/maxDistance: also drop instances farther than maxDistance (if > 0)
+    void cull(const Frustum& frustum, VisibleInstances& out,
+              const glm::vec3& eye = glm::vec3(0.0f), float maxDistance = 0.0f) const
+    {
+        cullSpheres(frustum, world, out.candidates, eye, maxDistance);
+        if (out.setVersion == version && out.candidates == out.indices)
+            return;
+        out.indices.swap(out.candidates);
+        out.setVersion = version;
+        gathered.clear();
+        for (std::uint32_t i : out.indices) gathered.push_back(all[i]);
+        out.buffer.update(gathered);
+    }
+
+    std::size_t size() const { return all.size(); }
+    const std::vector<glm::mat4>& transforms() const { return all; }
+    const SphereSet& bounds() const { return world; }
+
+private:
+    glm::vec3 centerOf(const glm::mat4& M) const { return glm::vec3(M * glm::vec4(local.center, 1.0f)); }
+    float radiusOf(const glm::mat4& M) const
+    {
+        float s = std::max(std::max(glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1]))),
+                           glm::length(glm::vec3(M[2])));
+        return local.radius * s;
+    }
+
+    BoundingSphere         local;
+    std::vector<glm::mat4> all;
+    SphereSet              world;
+    std::uint64_t          version = 0;
+    mutable std::vector<glm::mat4> gathered;   // upload scratch
+};
+
+#endif // INSTANCE_SET_H
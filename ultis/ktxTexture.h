@@ -0,0 +1,213 @@
+#ifndef KTX_TEXTURE_H
+#define KTX_TEXTURE_H
+
+#include "../lib/glad.h"
+#include "blockCompress.h"
+#include "mappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A block-compressed 2D texture with its whole mip chain, as stored in a KTX
+// (1.1) file next to the source image ("rock.jpg" -> "rock.jpg.ktx").
+// encode() builds it from decoded pixels, save()/load() write and map the
+// file; the levels go to glCompressedTexImage2D as they are.
+class KtxTexture
+{
+public:
+    struct Level {
+        int         width, height;
+        std::size_t offset, size;   // into bytes()
+    };
+
+    GLenum             format = 0;
+    int                width = 0, height = 0;
+    std::vector<Level> levels;      // 0 = full size, down to 1x1
+
+    bool valid() const { return !levels.empty(); }
+    int  channels() const { return BlockCompress::channelsOf(format); }
+    const unsigned char* bytes() const { return file ? file->data() : data.data(); }
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (const Level& lv : levels) n += lv.size;
+        return n;
+    }
+
+    // the cache of `source`, and whether it is at least as new as the source
+    static std::string pathFor(const std::string& source) { return source + ".ktx"; }
+    static bool upToDate(const std::string& source)
+    {
+        std::error_code ec;
+        auto cached = std::filesystem::last_write_time(pathFor(source), ec);
+        if (ec) return false;
+        auto original = std::filesystem::last_write_time(source, ec);
+        return !ec && cached >= original;
+    }
+
+    // compresses decoded pixels (1-4 channels) and every mip level below them
+    static KtxTexture encode(const unsigned char* pixels, int width, int height, int channels)
+    {
+        KtxTexture t;
+        t.format = BlockCompress::formatFor(channels);
+        t.width  = width;
+        t.height = height;
+
+        std::size_t total = 0;
+        for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+            t.levels.push_back(Level{w, h, total, BlockCompress::levelBytes(t.format, w, h)});
+            total += t.levels.back().size;
+            if (w == 1 && h == 1) break;
+        }
+        t.data.resize(total);
+
+        std::vector<unsigned char> level;
+        const unsigned char* src = pixels;
+        for (std::size_t l = 0; l < t.levels.size(); ++l) {
+            const Level& lv = t.levels[l];
+            if (l > 0) {
+                int w, h;
+                level = BlockCompress::downsample(src, t.levels[l - 1].width, t.levels[l - 1].height, channels, w, h);
+                src = level.data();
+            }
+            BlockCompress::encode(src, lv.width, lv.height, channels, t.data.data() + lv.offset);
+        }
+        return t;
+    }
+
+    // maps a file written by save(); false if it is missing or not one of ours
+    bool load(const std::string& path)
+    {
+        *this = KtxTexture();
+        auto map = std::make_unique<MappedFile>(path);
+        if (!map->valid() || map->size() < sizeof(Header)) return false;
+
+        Header hdr;
+        std::memcpy(&hdr, map->data(), sizeof hdr);
+        bool match = std::memcmp(hdr.identifier, kIdentifier, sizeof kIdentifier) == 0
+                  && hdr.endianness == 0x04030201 && hdr.glType == 0 && hdr.glFormat == 0
+                  && BlockCompress::channelsOf(hdr.glInternalFormat) != 0
+                  && hdr.pixelWidth > 0 && hdr.pixelHeight > 0 && hdr.pixelDepth == 0
+                  && hdr.numberOfArrayElements == 0 && hdr.numberOfFaces == 1
+                  && hdr.numberOfMipmapLevels > 0 && hdr.bytesOfKeyValueData == keyValueBytes();
+        std::size_t p = sizeof hdr;
+        if (!match || map->size() < p + hdr.bytesOfKeyValueData ||
+            std::memcmp(map->data() + p, keyValue().data(), hdr.bytesOfKeyValueData) != 0)
+            return false;
+        p += hdr.bytesOfKeyValueData;
+
+        format = hdr.glInternalFormat;
+        width  = int(hdr.pixelWidth);
+        height = int(hdr.pixelHeight);
+        int w = width, h = height;
+        for (std::uint32_t l = 0; l < hdr.numberOfMipmapLevels; ++l) {
+            std::uint32_t imageSize;
+            if (map->size() < p + sizeof imageSize) { levels.clear(); return false; }
+            std::memcpy(&imageSize, map->data() + p, sizeof imageSize);
+            p += sizeof imageSize;
+            if (imageSize != BlockCompress::levelBytes(format, w, h) || map->size() < p + imageSize) {
+                levels.clear();
+                return false;
+            }
+            levels.push_back(Level{w, h, p, imageSize});
+            p += (imageSize + 3) / 4 * 4;
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        map->prefetch(levels[0].offset, map->size() - levels[0].offset);
+        file = std::move(map);
+        return true;
+    }
+
+    // writes through a temp name and a rename, so a reader never maps a partial file
+    bool save(const std::string& path) const
+    {
+        Header hdr{};
+        std::memcpy(hdr.identifier, kIdentifier, sizeof kIdentifier);
+        hdr.endianness           = 0x04030201;
+        hdr.glTypeSize           = 1;
+        hdr.glInternalFormat     = format;
+        hdr.glBaseInternalFormat = baseFormat(channels());
+        hdr.pixelWidth           = std::uint32_t(width);
+        hdr.pixelHeight          = std::uint32_t(height);
+        hdr.numberOfFaces        = 1;
+        hdr.numberOfMipmapLevels = std::uint32_t(levels.size());
+        hdr.bytesOfKeyValueData  = keyValueBytes();
+
+        std::error_code ec;
+        std::string tmp = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(&hdr), sizeof hdr);
+            std::string kv = keyValue();
+            out.write(kv.data(), std::streamsize(kv.size()));
+            for (const Level& lv : levels) {
+                std::uint32_t imageSize = std::uint32_t(lv.size);
+                out.write(reinterpret_cast<const char*>(&imageSize), sizeof imageSize);
+                out.write(reinterpret_cast<const char*>(bytes() + lv.offset), std::streamsize(lv.size));
+            }
+            if (!out) {
+                std::cerr << "Failed to write texture cache " << tmp << "\n";
+                out.close();
+                std::filesystem::remove(tmp, ec);
+                return false;
+            }
+        }
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) {
+            std::cerr << "Failed to write texture cache " << path << ": " << ec.message() << "\n";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr unsigned char kIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    // bump the value whenever the encoder or the mip filter change
+    static constexpr const char kEncoderKey[]   = "BlockCompress";
+    static constexpr const char kEncoderValue[] = "1";
+
+    struct Header {
+        unsigned char identifier[12];
+        std::uint32_t endianness;
+        std::uint32_t glType, glTypeSize, glFormat;
+        std::uint32_t glInternalFormat, glBaseInternalFormat;
+        std::uint32_t pixelWidth, pixelHeight, pixelDepth;
+        std::uint32_t numberOfArrayElements, numberOfFaces, numberOfMipmapLevels;
+        std::uint32_t bytesOfKeyValueData;
+    };
+
+    static GLenum baseFormat(int channels)
+    {
+        switch (channels) {
+        case 1:  return GL_RED;
+        case 2:  return GL_RG;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    // the one key/value pair, padded to 4 bytes as KTX wants
+    static std::string keyValue()
+    {
+        std::string pair = std::string(kEncoderKey) + '\0' + kEncoderValue + '\0';
+        std::uint32_t n = std::uint32_t(pair.size());
+        std::string kv(reinterpret_cast<const char*>(&n), sizeof n);
+        kv += pair;
+        kv.resize((kv.size() + 3) / 4 * 4, '\0');
+        return kv;
+    }
+    static std::uint32_t keyValueBytes() { return std::uint32_t(keyValue().size()); }
+
+    std::vector<unsigned char>  data;   // encode()d
+    std::unique_ptr<MappedFile> file;   // or load()ed
+};
+
+#endif // KTX_TEXTURE_H
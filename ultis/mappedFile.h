@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. valid() is false if the file is
+// missing, empty or cannot be mapped; callers fall back to regenerating.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                ptr = static_cast<const unsigned char*>(p);
+                len = std::size_t(st.st_size);
+            }
+        }
+        ::close(fd);   // the mapping keeps the file alive
+    }
+
+    ~MappedFile()
+    {
+        if (ptr) ::munmap(const_cast<unsigned char*>(ptr), len);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool                 valid() const { return ptr != nullptr; }
+    const unsigned char* data()  const { return ptr; }
+    std::size_t          size()  const { return len; }
+
+    // ask the kernel to start paging [offset, offset+bytes) in, so a later
+    // read (e.g. a GL upload) does not stall on disk
+    void prefetch(std::size_t offset, std::size_t bytes) const
+    {
+        if (!ptr || offset >= len) return;
+        std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE));
+        std::size_t start = offset / page * page;
+        if (bytes > len - offset) bytes = len - offset;
+        ::madvise(const_cast<unsigned char*>(ptr) + start, offset + bytes - start, MADV_WILLNEED);
+    }
+
+private:
+    const unsigned char* ptr = nullptr;
+    std::size_t          len = 0;
+};
+
+#endif // MAPPED_FILE_H
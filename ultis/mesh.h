@@ -5,27 +5,59 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "shaderReader.h"
+#include "instanceBuffer.h"
+#include "renderQueue.h"
+#include "frustum.h"
+#include "textureHandle.h"
+#include "vertexLayout.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
+// a vertex as imported, full precision; the GPU gets it packed (VertexLayout)
 struct Vertex {
     glm::vec3 Position;
     glm::vec3 Normal;
     glm::vec2 TexCoords;
     glm::vec3 Tangent;
     glm::vec3 Bitangent;
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// the streams asked for, with half UVs when every UV fits them
+inline VertexLayout chooseVertexLayout(const Vertex *vertices, size_t count,
+                                       bool normals, bool texCoords, bool tangents) {
+    VertexLayout layout;
+    if (normals)  layout.streams |= VertexLayout::Normals;
+    if (tangents) layout.streams |= VertexLayout::Tangents;
+    if (texCoords) {
+        layout.streams |= VertexLayout::TexCoords;
+        for (size_t i = 0; i < count; i++) {
+            const glm::vec2 &uv = vertices[i].TexCoords;
+            if (std::max(std::abs(uv.x), std::abs(uv.y)) > VertexLayout::kHalfTexCoordLimit) {
+                layout.streams |= VertexLayout::FloatTexCoords;
+                break;
+            }
+        }
+    }
+    return layout;
+}
+
+inline vector<unsigned char> packVertices(const VertexLayout &layout, const Vertex *vertices, size_t count) {
+    vector<unsigned char> packed(count * layout.stride());
+    for (size_t i = 0; i < count; i++) {
+        const Vertex &v = vertices[i];
+        layout.pack(v.Position, v.Normal, v.TexCoords, v.Tangent, v.Bitangent, &packed[i * layout.stride()]);
+    }
+    return packed;
+}
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
+    TextureHandle handle;   // keeps id alive when it came from AssetLoader
 };
 
 class Mesh {
@@ -34,23 +66,97 @@ public:
     vector<unsigned int> indices;
     vector<Texture> textures;
     unsigned int VAO;
+    BoundingBox bounds;   // model space
+    VertexLayout layout;  // what the vertex buffer holds per vertex
 
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
-        setupMesh();
+        for (const Vertex& v : this->vertices)
+            bounds.expand(v.Position);
+        // tangents only go up for meshes with a normal map
+        bool normalMap = std::any_of(this->textures.begin(), this->textures.end(),
+                                     [](const Texture& tex) { return tex.type == "texture_normal"; });
+        layout = chooseVertexLayout(this->vertices.data(), this->vertices.size(), true, true, normalMap);
+        vector<unsigned char> packed = packVertices(layout, this->vertices.data(), this->vertices.size());
+        setupMaterial();
+        setupMesh(packed.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // uploads straight from memory the mesh does not keep (a mapped ModelCache),
+    // vertices already packed in `layout`; vertices and indices stay empty
+    Mesh(const VertexLayout &layout, const void *vertexData, size_t vertexCount,
+         const unsigned int *indexData, size_t indexCount,
+         vector<Texture> textures, const BoundingBox &bounds) {
+        this->textures = textures;
+        this->bounds = bounds;
+        this->layout = layout;
+        setupMaterial();
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
     }
 
     void Draw(Shader &shader) {
+        bindTextures(shader);
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // one draw for every transform in `instances` (shader reads aInstanceModel)
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances) {
+        if (instances.count() == 0)
+            return;
+        bindTextures(shader);
+        glBindVertexArray(VAO);
+        if (instanceVBO != instances.id()) {
+            instances.attach();
+            instanceVBO = instances.id();
+        }
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0,
+                                instances.count());
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // queues the instanced draw instead of issuing it; textured = false for
+    // depth-only passes, which don't sample the material
+    void Submit(RenderQueue &queue, Shader &shader, const InstanceBuffer &instances,
+                bool textured = true) {
+        DrawItem item;
+        item.shader     = &shader;
+        item.material   = textured ? &material : nullptr;
+        item.vao        = VAO;
+        item.indexCount = indexCount;
+        item.instances  = &instances;
+        item.attached   = &instanceVBO;
+        item.key = RenderQueue::makeKey(shader.ID, textured ? material.id : 0, VAO);
+        queue.push(item);
+    }
+private:
+    unsigned int VBO, EBO;
+    GLsizei indexCount = 0;
+    unsigned int instanceVBO = 0;   // instance buffer the VAO currently points at
+    // the textures with their sampler uniforms ("texture_diffuse1", ...), named and hashed once
+    Material material;
+
+    void bindTextures(Shader &shader) {
+        for (unsigned int i = 0; i < material.textures.size(); i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            shader.setInt(Uniform(material.samplerNames[i].c_str(), material.samplerKeys[i]), i);
+            glBindTexture(GL_TEXTURE_2D, material.textures[i]);
+        }
+    }
+
+    void setupMaterial() {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
         unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++) {
-            glActiveTexture(GL_TEXTURE0 + i);
+        for (const Texture& tex : textures) {
             string number;
-            string name = textures[i].type;
+            const string& name = tex.type;
             if (name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if (name == "texture_specular")
@@ -59,40 +165,21 @@ public:
                 number = std::to_string(normalNr++);
             else if (name == "texture_height")
                 number = std::to_string(heightNr++);
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            material.add(tex.id, name + number);
         }
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-        glActiveTexture(GL_TEXTURE0);
     }
-private:
-    unsigned int VBO, EBO;
 
-    void setupMesh() {
+    void setupMesh(const void *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount) {
+        this->indexCount = static_cast<GLsizei>(indexCount);
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.stride(), vertexData, GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Tangent));
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Bitangent));
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void *)offsetof(Vertex, m_BoneIDs));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, m_Weights));
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        layout.setupAttributes();
         glBindVertexArray(0);
     }
 };
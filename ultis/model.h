@@ -7,10 +7,11 @@
 #include "shaderReader.h"
 #include <vector>
 #include "mesh.h"
+#include "modelCache.h"
+#include "assetLoader.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include "../lib/stb_image.h"
 
 #include <string>
 #include <fstream>
@@ -20,19 +21,23 @@
 
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
-
 class Model 
 {
 public:
-    vector<Texture> textures_loaded;
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    BoundingBox bounds;   // all meshes, model space
 
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // imports on one of the loader's workers and loads the textures through
+    // it; meshes and bounds are filled in by a later assets.upload(), so the
+    // model must stay where it is until then
+    Model(AssetLoader &assets, string const &path, bool gamma = false)
+        : gammaCorrection(gamma), assets(&assets)
     {
-        loadModel(path);
+        directory = path.substr(0, path.find_last_of('/'));
+        assets.run<Import>([path]() { return importModel(path); },
+                           [this](Import &imported) { build(imported); });
     }
 
     void Draw(Shader &shader)
@@ -40,44 +45,100 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // every mesh once, instanced over `instances`
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instances);
+    }
+
+    // DrawInstanced through a render queue (see Mesh::Submit)
+    void Submit(RenderQueue &queue, Shader &shader, const InstanceBuffer &instances,
+                bool textured = true)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Submit(queue, shader, instances, textured);
+    }
     
 private:
-    void loadModel(string const &path)
+    AssetLoader *assets;
+
+    // the result of an import, before any GL: mesh views into either the
+    // mapped cache or the arrays filled from Assimp
+    struct Import {
+        ModelCache                    cache;
+        vector<vector<unsigned char>> vertices;   // packed in each view's layout
+        vector<vector<unsigned int>>  indices;
+        vector<ModelCache::MeshView>  meshes;
+    };
+
+    // no GL; safe on any thread
+    static Import importModel(string const &path)
     {
+        Import imported;
+        // warm start: the processed meshes straight from the mapped cache
+        if (imported.cache.open(path))
+        {
+            imported.meshes = imported.cache.meshes();
+            return imported;
+        }
+
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return imported;
         }
-        directory = path.substr(0, path.find_last_of('/'));
+        processNode(scene->mRootNode, scene, imported);
+        for (size_t i = 0; i < imported.meshes.size(); i++)
+        {
+            ModelCache::MeshView &m = imported.meshes[i];
+            m.vertices    = imported.vertices[i].data();
+            m.vertexCount = imported.vertices[i].size() / m.layout.stride();
+            m.indices     = imported.indices[i].data();
+            m.indexCount  = imported.indices[i].size();
+        }
+        ModelCache::save(path, imported.meshes);
+        return imported;
+    }
 
-        processNode(scene->mRootNode, scene);
+    // GL side: textures and buffers for every imported mesh
+    void build(const Import &imported)
+    {
+        for (const ModelCache::MeshView &m : imported.meshes)
+        {
+            vector<Texture> textures;
+            for (const ModelCache::TextureRef &ref : m.textures)
+                textures.push_back(loadTexture(ref.path.c_str(), ref.type));
+            meshes.emplace_back(m.layout, m.vertices, m.vertexCount, m.indices, m.indexCount, textures, m.bounds);
+            bounds.expand(m.bounds);
+        }
     }
 
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, Import &imported)
     {
         for(unsigned int i = 0; i < node->mNumMeshes; i++) 
         {
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            processMesh(mesh, scene, imported);
         }
         for(unsigned int i = 0; i < node->mNumChildren; i++) 
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, imported);
         }
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static void processMesh(aiMesh *mesh, const aiScene *scene, Import &imported)
     {
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
+        ModelCache::MeshView view;
 
         for(unsigned int i = 0; i < mesh->mNumVertices; i++) 
         {
-            Vertex vertex;
+            Vertex vertex{};
             glm::vec3 vector;
             vector.x = mesh->mVertices[i].x;
             vector.y = mesh->mVertices[i].y;
@@ -117,87 +178,46 @@ private:
                 indices.push_back(face.mIndices[j]);        
         }
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        return Mesh(vertices, indices, textures);
+        materialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", view.textures);
+        materialTextures(material, aiTextureType_SPECULAR, "texture_specular", view.textures);
+        materialTextures(material, aiTextureType_HEIGHT, "texture_normal", view.textures);
+        materialTextures(material, aiTextureType_AMBIENT, "texture_height", view.textures);
+
+        for (const Vertex& v : vertices)
+            view.bounds.expand(v.Position);
+        // only the streams this mesh has and its material uses: tangents go up
+        // for normal-mapped meshes only
+        bool normalMap = std::any_of(view.textures.begin(), view.textures.end(),
+                                     [](const ModelCache::TextureRef& tex) { return tex.type == "texture_normal"; });
+        view.layout = chooseVertexLayout(vertices.data(), vertices.size(), mesh->HasNormals(),
+                                         mesh->mTextureCoords[0] != nullptr,
+                                         normalMap && mesh->HasTangentsAndBitangents());
+        imported.vertices.push_back(packVertices(view.layout, vertices.data(), vertices.size()));
+        imported.indices.push_back(std::move(indices));
+        imported.meshes.push_back(std::move(view));
     }
 
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) 
+    static void materialTextures(aiMaterial *mat, aiTextureType type, const string &typeName,
+                                 vector<ModelCache::TextureRef> &out) 
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++) 
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++) 
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) 
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    break;
-                }
-            }
-            if(!skip) 
-            {
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
-            }
+            out.push_back(ModelCache::TextureRef{typeName, str.C_Str()});
         }
-        return textures;
     }
-};
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma) 
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) 
+    // through the loader's registry, shared with every other model and subsystem
+    Texture loadTexture(const char *path, const string &typeName)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } 
-    else 
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        Texture texture;
+        texture.handle = assets->texture(directory + '/' + path);
+        texture.id = texture.handle.id();
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
     }
-
-    return textureID;
-}
+};
 
 #endif
@@ -0,0 +1,329 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mappedFile.h"
+#include "mesh.h"
+
+// A model as the importer left it (after triangulation, normals and tangent
+// space, vertices packed per mesh, see VertexLayout), in a file that maps
+// straight into memory: vertex and index data are handed to glBufferData from
+// the mapping, so a warm start never runs Assimp.
+//
+// file = header, mesh records, texture records, dependency records, string
+// table, then each mesh's vertices and indices, every block 16-byte aligned.
+// A cache belongs to one source file and the material libraries it names
+// (an .obj's mtllib lines); it is ignored once any of their sizes or
+// modification times differ. The textures themselves are read as before.
+class ModelCache
+{
+public:
+    struct TextureRef {
+        std::string type;   // "texture_diffuse", ...
+        std::string path;   // relative to the model's directory
+    };
+
+    // one mesh, pointing into the mapping (or, for save, the importer's arrays)
+    struct MeshView {
+        VertexLayout        layout;
+        const unsigned char* vertices = nullptr;   // vertexCount * layout.stride() bytes
+        std::size_t         vertexCount = 0;
+        const unsigned int* indices = nullptr;
+        std::size_t         indexCount = 0;
+        std::vector<TextureRef> textures;
+        BoundingBox         bounds;
+    };
+
+    // maps the cache of `source`; false if there is none, or it is stale,
+    // truncated or from another version
+    bool open(const std::string& source)
+    {
+        meshViews.clear();
+        Stamp stamp;
+        if (!stampOf(source, stamp)) return false;
+        auto map = std::make_unique<MappedFile>(pathFor(source));
+        if (!map->valid() || map->size() < sizeof(Header)) return false;
+
+        Header hdr;
+        std::memcpy(&hdr, map->data(), sizeof hdr);
+        bool match = std::memcmp(hdr.magic, "MDC1", 4) == 0 && hdr.version == kVersion
+                  && hdr.indexSize == sizeof(unsigned int)
+                  && hdr.sourceSize == stamp.size && hdr.sourceTime == stamp.time;
+        if (!match) return false;
+
+        std::size_t tableEnd = align(sizeof hdr + hdr.meshCount * sizeof(MeshRecord)
+                                     + hdr.textureCount * sizeof(TextureRecord)
+                                     + hdr.dependencyCount * sizeof(DependencyRecord) + hdr.stringBytes);
+        if (map->size() < tableEnd) return false;
+
+        const unsigned char* base = map->data();
+        const unsigned char* texBase = base + sizeof hdr + hdr.meshCount * sizeof(MeshRecord);
+        const unsigned char* depBase = texBase + hdr.textureCount * sizeof(TextureRecord);
+        const char* strings = reinterpret_cast<const char*>(depBase + hdr.dependencyCount * sizeof(DependencyRecord));
+        auto str = [&](std::uint32_t offset, std::uint32_t length, std::string& out) {
+            if (std::uint64_t(offset) + length > hdr.stringBytes) return false;
+            out.assign(strings + offset, length);
+            return true;
+        };
+
+        // an edited (or removed) material library makes the cache stale too
+        for (std::uint32_t i = 0; i < hdr.dependencyCount; ++i) {
+            DependencyRecord dr;
+            std::memcpy(&dr, depBase + i * sizeof dr, sizeof dr);
+            std::string dep;
+            Stamp depStamp;
+            if (!str(dr.pathOffset, dr.pathLength, dep) || !stampOf(dep, depStamp) ||
+                depStamp.size != dr.size || depStamp.time != dr.time)
+                return false;
+        }
+
+        std::vector<MeshView> views(hdr.meshCount);
+        for (std::uint32_t i = 0; i < hdr.meshCount; ++i) {
+            MeshRecord rec;
+            std::memcpy(&rec, base + sizeof hdr + i * sizeof rec, sizeof rec);
+            VertexLayout layout;
+            layout.streams = rec.layout;
+            std::uint64_t vertexBytes = rec.vertexCount * layout.stride();
+            std::uint64_t indexBytes  = rec.indexCount * sizeof(unsigned int);
+            if ((rec.layout & ~std::uint32_t(VertexLayout::AllStreams)) != 0 ||
+                rec.vertexOffset < tableEnd || rec.vertexOffset + vertexBytes > map->size() ||
+                rec.indexOffset < tableEnd || rec.indexOffset + indexBytes > map->size() ||
+                std::uint64_t(rec.firstTexture) + rec.textureCount > hdr.textureCount)
+                return false;
+
+            MeshView& v = views[i];
+            v.layout      = layout;
+            v.vertices    = base + rec.vertexOffset;
+            v.vertexCount = rec.vertexCount;
+            v.indices     = reinterpret_cast<const unsigned int*>(base + rec.indexOffset);
+            v.indexCount  = rec.indexCount;
+            v.bounds.min  = glm::vec3(rec.boundsMin[0], rec.boundsMin[1], rec.boundsMin[2]);
+            v.bounds.max  = glm::vec3(rec.boundsMax[0], rec.boundsMax[1], rec.boundsMax[2]);
+            for (std::uint32_t t = 0; t < rec.textureCount; ++t) {
+                TextureRecord tr;
+                std::memcpy(&tr, texBase + (rec.firstTexture + t) * sizeof tr, sizeof tr);
+                TextureRef ref;
+                if (!str(tr.typeOffset, tr.typeLength, ref.type) ||
+                    !str(tr.pathOffset, tr.pathLength, ref.path))
+                    return false;
+                v.textures.push_back(std::move(ref));
+            }
+            map->prefetch(std::size_t(rec.vertexOffset), std::size_t(vertexBytes));
+            map->prefetch(std::size_t(rec.indexOffset), std::size_t(indexBytes));
+        }
+
+        meshViews.swap(views);
+        file = std::move(map);
+        return true;
+    }
+
+    // valid until the next open() or the cache goes away
+    const std::vector<MeshView>& meshes() const { return meshViews; }
+
+    // writes the cache of `source` from freshly imported meshes
+    static void save(const std::string& source, const std::vector<MeshView>& meshes)
+    {
+        Stamp stamp;
+        if (!stampOf(source, stamp)) return;
+
+        std::vector<MeshRecord>       records(meshes.size());
+        std::vector<TextureRecord>    textures;
+        std::vector<DependencyRecord> dependencies;
+        std::string                   strings;
+        auto addString = [&strings](const std::string& s, std::uint32_t& offset, std::uint32_t& length) {
+            offset = std::uint32_t(strings.size());
+            length = std::uint32_t(s.size());
+            strings += s;
+        };
+        for (const std::string& dep : materialLibraries(source)) {
+            Stamp depStamp;
+            if (!stampOf(dep, depStamp)) continue;   // Assimp went without it as well
+            DependencyRecord dr{};
+            addString(dep, dr.pathOffset, dr.pathLength);
+            dr.size = depStamp.size;
+            dr.time = depStamp.time;
+            dependencies.push_back(dr);
+        }
+        for (std::size_t i = 0; i < meshes.size(); ++i) {
+            const MeshView& m = meshes[i];
+            MeshRecord& rec = records[i];
+            rec.layout       = m.layout.streams;
+            rec.vertexCount  = m.vertexCount;
+            rec.indexCount   = m.indexCount;
+            rec.firstTexture = std::uint32_t(textures.size());
+            rec.textureCount = std::uint32_t(m.textures.size());
+            for (int k = 0; k < 3; ++k) {
+                rec.boundsMin[k] = m.bounds.min[k];
+                rec.boundsMax[k] = m.bounds.max[k];
+            }
+            for (const TextureRef& tex : m.textures) {
+                TextureRecord tr{};
+                addString(tex.type, tr.typeOffset, tr.typeLength);
+                addString(tex.path, tr.pathOffset, tr.pathLength);
+                textures.push_back(tr);
+            }
+        }
+
+        Header hdr{};
+        std::memcpy(hdr.magic, "MDC1", 4);
+        hdr.version      = kVersion;
+        hdr.indexSize    = sizeof(unsigned int);
+        hdr.meshCount    = std::uint32_t(records.size());
+        hdr.textureCount = std::uint32_t(textures.size());
+        hdr.stringBytes  = std::uint32_t(strings.size());
+        hdr.dependencyCount = std::uint32_t(dependencies.size());
+        hdr.sourceSize   = stamp.size;
+        hdr.sourceTime   = stamp.time;
+
+        std::uint64_t offset = align(sizeof hdr + records.size() * sizeof(MeshRecord)
+                                     + textures.size() * sizeof(TextureRecord)
+                                     + dependencies.size() * sizeof(DependencyRecord) + strings.size());
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            MeshRecord& rec = records[i];
+            rec.vertexOffset = offset;
+            offset = align(offset + rec.vertexCount * meshes[i].layout.stride());
+            rec.indexOffset = offset;
+            offset = align(offset + rec.indexCount * sizeof(unsigned int));
+        }
+
+        // write to a temp name and rename, so a reader never maps a partial file
+        std::error_code ec;
+        std::filesystem::create_directories(kDir, ec);
+        std::string path = pathFor(source);
+        std::string tmp  = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            std::uint64_t written = 0;
+            auto put = [&](const void* p, std::uint64_t n) {
+                out.write(static_cast<const char*>(p), std::streamsize(n));
+                written += n;
+            };
+            auto pad = [&]() {
+                static const char zeros[kAlign] = {};
+                put(zeros, align(written) - written);
+            };
+            put(&hdr, sizeof hdr);
+            put(records.data(), records.size() * sizeof(MeshRecord));
+            put(textures.data(), textures.size() * sizeof(TextureRecord));
+            put(dependencies.data(), dependencies.size() * sizeof(DependencyRecord));
+            put(strings.data(), strings.size());
+            pad();
+            for (std::size_t i = 0; i < meshes.size(); ++i) {
+                put(meshes[i].vertices, records[i].vertexCount * meshes[i].layout.stride());
+                pad();
+                put(meshes[i].indices, records[i].indexCount * sizeof(unsigned int));
+                pad();
+            }
+            if (!out) {
+                std::cerr << "Failed to write model cache " << tmp << "\n";
+                out.close();
+                std::filesystem::remove(tmp, ec);
+                return;
+            }
+        }
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) std::cerr << "Failed to write model cache " << path << ": " << ec.message() << "\n";
+    }
+
+private:
+    // bump kVersion whenever the import flags, processMesh or VertexLayout change
+    static constexpr const char*   kDir     = "cache/models";
+    static constexpr std::uint32_t kVersion = 4;
+    static constexpr std::size_t   kAlign   = 16;
+
+    struct Header {
+        char          magic[4];
+        std::uint32_t version;
+        std::uint32_t indexSize;
+        std::uint32_t meshCount, textureCount, stringBytes;
+        std::uint32_t dependencyCount, pad0;
+        // the source file the cache was made from; both must match
+        std::uint64_t sourceSize;
+        std::int64_t  sourceTime;
+    };
+
+    struct MeshRecord {
+        std::uint64_t vertexOffset, vertexCount;   // from the start of the file
+        std::uint64_t indexOffset, indexCount;
+        std::uint32_t firstTexture, textureCount;  // into the texture records
+        float         boundsMin[3], boundsMax[3];
+        std::uint32_t layout;                      // VertexLayout::streams
+        std::uint32_t pad0;
+    };
+
+    struct TextureRecord {
+        std::uint32_t typeOffset, typeLength;      // into the string table
+        std::uint32_t pathOffset, pathLength;
+    };
+
+    // a file the import read besides the source, stamped like it
+    struct DependencyRecord {
+        std::uint32_t pathOffset, pathLength;      // into the string table
+        std::uint64_t size;
+        std::int64_t  time;
+    };
+
+    struct Stamp {
+        std::uint64_t size = 0;
+        std::int64_t  time = 0;
+    };
+
+    static std::uint64_t align(std::uint64_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+    static bool stampOf(const std::string& source, Stamp& stamp)
+    {
+        std::error_code ec;
+        stamp.size = std::filesystem::file_size(source, ec);
+        if (ec) return false;
+        auto time = std::filesystem::last_write_time(source, ec);
+        if (ec) return false;
+        stamp.time = std::int64_t(time.time_since_epoch().count());
+        return true;
+    }
+
+    // the .mtl files an .obj names (mtllib), next to it; other formats
+    // keep their materials inside the source
+    static std::vector<std::string> materialLibraries(const std::string& source)
+    {
+        std::vector<std::string> libs;
+        std::filesystem::path src(source);
+        std::string ext = src.extension().string();
+        if (ext != ".obj" && ext != ".OBJ") return libs;
+        std::ifstream in(source);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream words(line);
+            std::string word;
+            if (!(words >> word) || word != "mtllib") continue;
+            while (words >> word)
+                libs.push_back((src.parent_path() / word).string());
+        }
+        return libs;
+    }
+
+    // FNV-1a over the source path, so every model gets its own file
+    static std::string pathFor(const std::string& source)
+    {
+        std::uint64_t h = 1469598103934665603ull;
+        for (unsigned char c : source) { h ^= c; h *= 1099511628211ull; }
+        char name[64];
+        std::snprintf(name, sizeof name, "/%016llx.mdl", (unsigned long long)h);
+        return kDir + std::string(name);
+    }
+
+    std::unique_ptr<MappedFile> file;
+    std::vector<MeshView>       meshViews;
+};
+
+#endif // MODEL_CACHE_H
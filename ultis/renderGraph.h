@@ -0,0 +1,158 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "../lib/glad.h"
+#include <glm/glm.hpp>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The frame's render passes, declared up front and then run in one go.
+//
+// Each pass names the target it draws into, the targets it samples, its
+// camera and its clip plane; the draw callback only issues draw calls.
+// execute():
+//   - skips passes that are disabled or whose target nothing live reads
+//     (the backbuffer is always read), so e.g. the water's reflection and
+//     refraction disappear with the water
+//   - binds a target (and sets its viewport) only when it changes, and clears
+//     it once, before the first pass of the frame that draws into it
+//   - hands each pass's camera to onCamera only when it differs from the
+//     previous pass's, so passes sharing a camera share one upload
+// Passes run in declaration order, which has to respect their reads.
+class RenderGraph
+{
+public:
+    using Target = int;
+    static const Target kBackbuffer = 0;
+
+    struct Camera {
+        glm::mat4 view       = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        glm::vec3 position   = glm::vec3(0.0f);
+    };
+
+    struct Pass {
+        std::string         name;
+        Target              target = kBackbuffer;
+        std::vector<Target> reads;
+        bool                enabled = true;
+        bool                hasCamera = false;   // false: leaves the camera alone
+        Camera              camera;
+        bool                clip = false;        // enables gl_ClipDistance[0]
+        glm::vec4           clipPlane = glm::vec4(0.0f);
+        std::function<void(const Pass&)> draw;
+
+        Pass& reading(Target t)               { reads.push_back(t); return *this; }
+        Pass& withCamera(const Camera& c)     { camera = c; hasCamera = true; return *this; }
+        Pass& clippedBy(const glm::vec4& p)   { clipPlane = p; clip = true; return *this; }
+        Pass& enabledIf(bool on)              { enabled = on; return *this; }
+    };
+
+    RenderGraph(int screenWidth, int screenHeight)
+    {
+        targets.push_back(TargetInfo{"backbuffer", 0, screenWidth, screenHeight,
+                                     GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT});
+    }
+
+    // an offscreen framebuffer; clearMask is applied before its first pass each frame
+    Target addTarget(const char* name, GLuint fbo, int width, int height, GLbitfield clearMask)
+    {
+        targets.push_back(TargetInfo{name, fbo, width, height, clearMask});
+        return Target(targets.size() - 1);
+    }
+
+    void setScreenSize(int width, int height)
+    {
+        targets[kBackbuffer].width = width;
+        targets[kBackbuffer].height = height;
+    }
+
+    // uploads a pass camera (e.g. to the Camera uniform block)
+    void onCamera(std::function<void(const Camera&)> fn) { cameraHook = std::move(fn); }
+
+    // drop last frame's passes; declare this frame's with addPass
+    void beginFrame() { passes.clear(); }
+
+    Pass& addPass(const std::string& name, Target target, std::function<void(const Pass&)> draw)
+    {
+        passes.emplace_back();
+        Pass& p = passes.back();
+        p.name = name;
+        p.target = target;
+        p.draw = std::move(draw);
+        return p;
+    }
+
+    void execute()
+    {
+        // which passes feed the backbuffer, walking back from the end
+        std::vector<bool> needed(targets.size(), false), live(passes.size(), false);
+        needed[kBackbuffer] = true;
+        for (std::size_t i = passes.size(); i-- > 0;) {
+            const Pass& p = passes[i];
+            if (!p.enabled || !needed[p.target]) continue;
+            live[i] = true;
+            for (Target t : p.reads) needed[t] = true;
+        }
+
+        std::vector<bool> cleared(targets.size(), false);
+        Target bound = -1;
+        bool clipping = false, haveCamera = false;
+        Camera current;
+        executed.clear();
+        for (std::size_t i = 0; i < passes.size(); ++i) {
+            if (!live[i]) continue;
+            const Pass& p = passes[i];
+            const TargetInfo& t = targets[p.target];
+            if (p.target != bound) {
+                glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+                glViewport(0, 0, t.width, t.height);
+                bound = p.target;
+            }
+            if (!cleared[p.target]) {
+                glClear(t.clearMask);
+                cleared[p.target] = true;
+            }
+            if (p.clip != clipping) {
+                if (p.clip) glEnable(GL_CLIP_DISTANCE0); else glDisable(GL_CLIP_DISTANCE0);
+                clipping = p.clip;
+            }
+            if (p.hasCamera && cameraHook &&
+                (!haveCamera || std::memcmp(&current, &p.camera, sizeof(Camera)) != 0)) {
+                cameraHook(p.camera);
+                current = p.camera;
+                haveCamera = true;
+            }
+            p.draw(p);
+            executed.push_back(p.name);
+        }
+        if (clipping) glDisable(GL_CLIP_DISTANCE0);
+        if (bound != kBackbuffer) {
+            const TargetInfo& t = targets[kBackbuffer];
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, t.width, t.height);
+        }
+    }
+
+    // names of the passes the last execute() ran, in order
+    const std::vector<std::string>& executedPasses() const { return executed; }
+    std::size_t passCount() const { return passes.size(); }
+
+private:
+    struct TargetInfo {
+        const char* name;
+        GLuint      fbo;
+        int         width, height;
+        GLbitfield  clearMask;
+    };
+
+    std::vector<TargetInfo>  targets;
+    std::deque<Pass>         passes;     // deque: addPass references stay valid
+    std::vector<std::string> executed;
+    std::function<void(const Camera&)> cameraHook;
+};
+
+#endif // RENDER_GRAPH_H
@@ -0,0 +1,157 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "../lib/glad.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "shaderReader.h"
+#include "instanceBuffer.h"
+#include "glState.h"
+
+// The textures a mesh draws with, one per unit, and the sampler uniform each
+// unit feeds ("texture_diffuse1", ...). Meshes with the same textures share
+// an id, which is what the render queue sorts on.
+struct Material
+{
+    std::vector<GLuint>        textures;       // textures[i] goes on unit i
+    std::vector<std::string>   samplerNames;
+    std::vector<std::uint64_t> samplerKeys;    // Uniform::hash of each name
+    std::uint16_t              id = 0;         // 0: no textures
+
+    void add(GLuint texture, std::string sampler)
+    {
+        textures.push_back(texture);
+        samplerKeys.push_back(Uniform::hash(sampler.c_str()));
+        samplerNames.push_back(std::move(sampler));
+        id = intern(textures);
+    }
+
+    // binds the textures; the sampler uniforms are program state, so they
+    // only need setting when the program or the material changed
+    void bind(Shader& shader, GLStateCache& state, bool setSamplers) const
+    {
+        for (std::size_t i = 0; i < textures.size(); ++i) {
+            if (setSamplers)
+                shader.setInt(Uniform(samplerNames[i].c_str(), samplerKeys[i]), int(i));
+            state.bindTexture2D(int(i), textures[i]);
+        }
+    }
+
+private:
+    static std::uint16_t intern(const std::vector<GLuint>& textures)
+    {
+        static std::map<std::vector<GLuint>, std::uint16_t> ids;
+        auto it = ids.find(textures);
+        if (it != ids.end()) return it->second;
+        std::uint16_t next = std::uint16_t(ids.size() + 1);
+        ids.emplace(textures, next);
+        return next;
+    }
+};
+
+// One indexed draw, instanced or not, with everything needed to issue it.
+struct DrawItem
+{
+    std::uint64_t         key = 0;              // RenderQueue::makeKey
+    Shader*               shader = nullptr;
+    const Material*       material = nullptr;   // null: no textures (depth passes)
+    GLuint                vao = 0;
+    GLsizei               indexCount = 0;
+    const InstanceBuffer* instances = nullptr;  // null: a single draw
+    GLuint*               attached = nullptr;   // instance buffer the VAO points at, kept by its owner
+};
+
+// Draws collected during a pass and issued together, ordered by their keys so
+// that draws sharing a program, then textures, then a VAO run back to back.
+// Binds go through a GLStateCache, so whatever the order leaves unchanged
+// costs nothing.
+class RenderQueue
+{
+public:
+    // most significant first:  program 16 | material 16 | vao 16
+    static std::uint64_t makeKey(GLuint program, unsigned material, GLuint vao)
+    {
+        return (std::uint64_t(program  & 0xFFFFu) << 32) |
+               (std::uint64_t(material & 0xFFFFu) << 16) |
+               std::uint64_t(vao & 0xFFFFu);
+    }
+
+    void push(const DrawItem& item) { items.push_back(item); }
+    std::size_t size() const { return items.size(); }
+
+    // sorts, issues and clears the queued draws. state has to be current:
+    // invalidate it after drawing around it
+    void submit(GLStateCache& state)
+    {
+        sort();
+        int material = -1;   // Material::id whose samplers are set and textures bound
+        for (const Entry& e : entries) {
+            const DrawItem& d = items[e.item];
+            bool newProgram = state.useProgram(d.shader->ID);
+            if (d.material && (newProgram || d.material->id != material)) {
+                d.material->bind(*d.shader, state, true);
+                material = d.material->id;
+            }
+
+            state.bindVertexArray(d.vao);
+            if (d.instances) {
+                if (d.instances->count() == 0) continue;
+                if (d.attached && *d.attached != d.instances->id()) {
+                    d.instances->attach();
+                    *d.attached = d.instances->id();
+                }
+                glDrawElementsInstanced(GL_TRIANGLES, d.indexCount, GL_UNSIGNED_INT, nullptr,
+                                        d.instances->count());
+            } else {
+                glDrawElements(GL_TRIANGLES, d.indexCount, GL_UNSIGNED_INT, nullptr);
+            }
+        }
+        state.bindVertexArray(0);
+        state.resetActiveUnit();
+        items.clear();
+    }
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        std::uint32_t item;
+    };
+
+    // LSD radix sort on the key, a byte at a time; bytes every key shares
+    // (most of them, with a handful of programs and VAOs) are skipped
+    void sort()
+    {
+        const std::size_t n = items.size();
+        entries.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+            entries[i] = Entry{items[i].key, std::uint32_t(i)};
+        if (n < 2) return;
+
+        std::uint32_t counts[8][256] = {};
+        for (const Entry& e : entries)
+            for (int b = 0; b < 8; ++b)
+                ++counts[b][(e.key >> (8 * b)) & 0xFF];
+
+        scratch.resize(n);
+        for (int b = 0; b < 8; ++b) {
+            std::uint32_t* c = counts[b];
+            if (c[(entries[0].key >> (8 * b)) & 0xFF] == n) continue;
+            std::uint32_t offset = 0;
+            for (int d = 0; d < 256; ++d) {
+                std::uint32_t k = c[d];
+                c[d] = offset;
+                offset += k;
+            }
+            for (const Entry& e : entries)
+                scratch[c[(e.key >> (8 * b)) & 0xFF]++] = e;
+            entries.swap(scratch);
+        }
+    }
+
+    std::vector<DrawItem> items;
+    std::vector<Entry>    entries, scratch;
+};
+
+#endif // RENDER_QUEUE_H
@@ -5,9 +5,33 @@
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+
+// A uniform name plus its 64-bit FNV-1a key. Passing a literal hashes it in
+// place (constant-folded by the compiler), so setX("model", ...) is a hash
+// map probe instead of a std::string and a glGetUniformLocation call.
+// Names built at runtime should be hashed once and kept (see Material in
+// renderQueue.h).
+struct Uniform
+{
+    const char*   name;
+    std::uint64_t key;
+
+    constexpr Uniform(const char* n) : name(n), key(hash(n)) {}
+    constexpr Uniform(const char* n, std::uint64_t k) : name(n), key(k) {}
+    Uniform(const std::string& n) : name(n.c_str()), key(hash(n.c_str())) {}
+
+    static constexpr std::uint64_t hash(const char* s)
+    {
+        std::uint64_t h = 14695981039346656037ull;
+        for (; *s; ++s) h = (h ^ std::uint8_t(*s)) * 1099511628211ull;
+        return h;
+    }
+};
 
 class Shader
 {
@@ -89,6 +113,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniformLocations();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -102,66 +127,110 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // cached location of a uniform; names the linker did not report (or that
+    // do not exist, -1) are looked up once and remembered as well
+    // ------------------------------------------------------------------------
+    GLint location(const Uniform &u) const
+    {
+        auto it = uniformLocations.find(u.key);
+        if (it != uniformLocations.end()) return it->second;
+        GLint loc = glGetUniformLocation(ID, u.name);
+        uniformLocations.emplace(u.key, loc);
+        return loc;
+    }
+    // attach the named uniform block to a binding point (no-op if unused)
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char *block, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, block);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const Uniform &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const Uniform &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const Uniform &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const Uniform &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const Uniform &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const Uniform &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const Uniform &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const Uniform &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(const Uniform &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const Uniform &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const Uniform &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const Uniform &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    mutable std::unordered_map<std::uint64_t, GLint> uniformLocations;
+
+    // resolve every active uniform once after linking. Arrays are reported
+    // by their first element ("lights[0]"), so the bare name is added too;
+    // struct arrays are reported member by member ("spotLights[3].Position").
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLen = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+        std::string name(std::size_t(maxLen > 0 ? maxLen : 1), '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei len = 0; GLint size = 0; GLenum type = 0;
+            glGetActiveUniform(ID, GLuint(i), maxLen, &len, &size, &type, &name[0]);
+            std::string n(name.data(), std::size_t(len));
+            GLint loc = glGetUniformLocation(ID, n.c_str());
+            if (loc < 0) continue;   // lives in a uniform block
+            uniformLocations[Uniform::hash(n.c_str())] = loc;
+            if (n.size() > 3 && n.compare(n.size()-3, 3, "[0]") == 0)
+                uniformLocations[Uniform::hash(n.substr(0, n.size()-3).c_str())] = loc;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,26 @@
+#ifndef TEXTURE_HANDLE_H
+#define TEXTURE_HANDLE_H
+
+#include "../lib/glad.h"
+#include <memory>
+
+// One user's share of a texture from AssetLoader's registry. Copies share
+// it; the GL texture is deleted when the last copy goes away.
+class TextureHandle
+{
+public:
+    TextureHandle() = default;
+
+    GLuint id() const { return texture ? *texture : 0; }
+    explicit operator bool() const { return texture != nullptr; }
+    // how many handles share the texture
+    long users() const { return texture.use_count(); }
+
+private:
+    friend class AssetLoader;
+    explicit TextureHandle(std::shared_ptr<const GLuint> t) : texture(std::move(t)) {}
+
+    std::shared_ptr<const GLuint> texture;
+};
+
+#endif // TEXTURE_HANDLE_H
@@ -0,0 +1,45 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include "../lib/glad.h"
+
+// One std140 uniform block's worth of data in a buffer that stays bound to a
+// fixed binding point; programs pick it up via Shader::bindUniformBlock.
+// T has to mirror the GLSL block byte for byte (vec3 + scalar share 16 bytes,
+// explicit padding at the end).
+template <typename T>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(GLuint binding) : binding(binding)
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+    }
+
+    ~UniformBuffer()
+    {
+        glDeleteBuffers(1, &ubo);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void update(const T& data) const
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    GLuint bindingPoint() const { return binding; }
+
+private:
+    GLuint ubo = 0;
+    GLuint binding;
+};
+
+#endif // UNIFORM_BUFFER_H
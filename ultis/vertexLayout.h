@@ -0,0 +1,116 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "../lib/glad.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// What a mesh vertex holds on the GPU, picked per mesh at import. Position is
+// always three floats; the rest is optional and packed:
+//   Normals     4 bytes      snorm 10-10-10-2 (GL_INT_2_10_10_10_REV)
+//   TexCoords   4 / 8 bytes  two halves within [-1, 1], else floats (FloatTexCoords)
+//   Tangents    4 bytes      snorm 10-10-10-2, w = bitangent sign (B = cross(N, T) * sign(w))
+// i.e. 20 or 24 bytes for what lit.vs reads, against 88 when every vertex
+// carried float normals, tangent frames and bone slots.
+// The attributes keep their locations (0 position, 1 normal, 2 uv, 3 tangent)
+// and GL unpacks them, so the shaders read plain vec3/vec2/vec4.
+struct VertexLayout
+{
+    enum Stream : std::uint32_t {
+        Normals        = 1u << 0,
+        TexCoords      = 1u << 1,
+        Tangents       = 1u << 2,
+        FloatTexCoords = 1u << 3,   // with TexCoords: beyond [-1, 1] (tiling UVs)
+        AllStreams     = (1u << 4) - 1
+    };
+
+    std::uint32_t streams = 0;
+
+    bool has(Stream s) const { return (streams & s) != 0; }
+
+    std::size_t normalOffset()   const { return 12; }
+    std::size_t texCoordOffset() const { return normalOffset() + (has(Normals) ? 4 : 0); }
+    std::size_t tangentOffset()  const { return texCoordOffset() + (has(TexCoords) ? (has(FloatTexCoords) ? 8 : 4) : 0); }
+    std::size_t stride()         const { return tangentOffset() + (has(Tangents) ? 4 : 0); }
+
+    // halves step by 1/2048 just below 1, under a texel on the 1-2K textures
+    // used here; a step coarser than that (1/1024 from 1 up) shows, so keep floats
+    static constexpr float kHalfTexCoordLimit = 1.0f;
+
+    static std::uint32_t packSnorm10(const glm::vec3& v, float w)
+    {
+        auto q = [](float x) {
+            return std::uint32_t(std::lround(std::min(std::max(x, -1.0f), 1.0f) * 511.0f)) & 0x3FFu;
+        };
+        std::uint32_t sw = std::uint32_t(std::lround(std::min(std::max(w, -1.0f), 1.0f))) & 0x3u;
+        return q(v.x) | (q(v.y) << 10) | (q(v.z) << 20) | (sw << 30);
+    }
+
+    // float -> IEEE half, round to nearest; out-of-range values saturate
+    static std::uint16_t toHalf(float f)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &f, sizeof bits);
+        std::uint16_t sign = std::uint16_t((bits >> 16) & 0x8000u);
+        float a = std::abs(f);
+        if (!(a < 65520.0f)) return std::uint16_t(sign | (a != a ? 0x7E00u : 0x7BFFu));
+        if (a < 6.1035156e-05f)                                   // subnormal: steps of 2^-24
+            return std::uint16_t(sign | std::uint16_t(std::lround(a * 16777216.0f)));
+        std::uint32_t abits = bits & 0x7FFFFFFFu;
+        std::uint32_t h = ((abits >> 13) - ((127u - 15u) << 10));
+        h += ((abits >> 12) & 1u);                                // round half up on the mantissa
+        return std::uint16_t(sign | std::min<std::uint32_t>(h, 0x7BFFu));
+    }
+
+    // writes one vertex at `out` (stride() bytes)
+    void pack(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv,
+              const glm::vec3& tangent, const glm::vec3& bitangent, unsigned char* out) const
+    {
+        std::memcpy(out, &position, 12);
+        if (has(Normals)) {
+            std::uint32_t n = packSnorm10(normal, 0.0f);
+            std::memcpy(out + normalOffset(), &n, 4);
+        }
+        if (has(TexCoords)) {
+            if (has(FloatTexCoords)) {
+                std::memcpy(out + texCoordOffset(), &uv, 8);
+            } else {
+                std::uint16_t h[2] = {toHalf(uv.x), toHalf(uv.y)};
+                std::memcpy(out + texCoordOffset(), h, 4);
+            }
+        }
+        if (has(Tangents)) {
+            float sign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+            std::uint32_t t = packSnorm10(tangent, sign);
+            std::memcpy(out + tangentOffset(), &t, 4);
+        }
+    }
+
+    // attribute pointers for the bound VAO/VBO; absent streams stay disabled
+    // (their attributes read as (0,0,0,1))
+    void setupAttributes() const
+    {
+        GLsizei s = GLsizei(stride());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, s, (void *)0);
+        if (has(Normals)) {
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, s, (void *)normalOffset());
+        }
+        if (has(TexCoords)) {
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, has(FloatTexCoords) ? GL_FLOAT : GL_HALF_FLOAT, GL_FALSE, s,
+                                  (void *)texCoordOffset());
+        }
+        if (has(Tangents)) {
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, s, (void *)tangentOffset());
+        }
+    }
+};
+
+#endif // VERTEX_LAYOUT_H